@@ -6,19 +6,26 @@
 
 TEMPLATE = app
 
-QT += core
-QT -= gui
+include(core.pri)
 
 CONFIG += console
 CONFIG -= app_bundle
 
 SOURCES += \
     main.cpp \
-    script.cpp \
-    cleaner.cpp
+    cleaner.cpp \
+    compression.cpp \
+    matroska.cpp \
+    archive.cpp \
+    incremental.cpp
 
 HEADERS += \
-    script.h \
-    cleaner.h
+    cleaner.h \
+    compression.h \
+    matroska.h \
+    archive.h \
+    incremental.h
+
+LIBS += -lz -lzstd
 
 TARGET = SubCleaner
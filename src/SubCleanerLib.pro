@@ -0,0 +1,37 @@
+#-------------------------------------------------
+#
+# Embeddable library: C++ API (engine.h) and C API (subcleaner.h)
+#
+#-------------------------------------------------
+
+TEMPLATE = lib
+
+include(core.pri)
+
+CONFIG += shared
+DEFINES += SUBCLEANER_BUILD
+
+SOURCES += \
+    subcleaner.cpp
+
+HEADERS += \
+    subcleaner.h
+
+TARGET = subcleaner
+VERSION = 2.0.0
+
+# C API и C++ API ядра (engine.h со всеми включаемыми заголовками).
+# Классы C++ не помечены для экспорта из DLL: на Windows доступен только C API.
+headers.files = \
+    subcleaner.h \
+    engine.h \
+    script.h \
+    litescript.h \
+    tagfilter.h \
+    eventfilter.h \
+    headerpolicy.h \
+    timeindex.h \
+    timing.h
+headers.path = $$[QT_INSTALL_HEADERS]/subcleaner
+target.path = $$[QT_INSTALL_LIBS]
+INSTALLS += target headers
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Qt-free build: UTF-8 SSA/ASS only, small static binary
+#
+#-------------------------------------------------
+
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    litemain.cpp \
+    litescript.cpp
+
+HEADERS += \
+    litescript.h
+
+QMAKE_LFLAGS += -static
+
+TARGET = SubCleanerLite
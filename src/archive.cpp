@@ -0,0 +1,401 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "archive.h"
+#include <QtEndian>
+#include <cstring>
+#include <zlib.h>
+
+namespace Archive
+{
+namespace
+{
+const int tarBlock = 512;
+
+//
+// tar
+//
+quint64 ParseOctal(const char* field, const int len)
+{
+    quint64 value = 0;
+    for (int i = 0; i < len && field[i] >= '0' && field[i] <= '7'; ++i) value = value * 8 + static_cast<quint64>(field[i] - '0');
+    return value;
+}
+
+QByteArray Field(const char* field, const int len)
+{
+    return QByteArray(field, static_cast<int>(qstrnlen(field, static_cast<uint>(len))));
+}
+
+// Расширенный заголовок pax: записи "длина ключ=значение\n"
+QByteArray PaxPath(const QByteArray& records)
+{
+    QByteArray path;
+    for (int pos = 0; pos < records.size(); )
+    {
+        const int space = records.indexOf(' ', pos);
+        const int len = space > pos ? records.mid(pos, space - pos).toInt() : 0;
+        if (len <= 0 || pos + len > records.size()) break;
+
+        const QByteArray record = records.mid(space + 1, pos + len - space - 2);
+        if ( record.startsWith("path=") ) path = record.mid(5);
+        pos += len;
+    }
+    return path;
+}
+
+bool ReadTar(const QByteArray& data, QList<Member>& members, QString* error)
+{
+    QByteArray longName;
+    for (int pos = 0; pos + tarBlock <= data.size(); )
+    {
+        const char* const header = data.constData() + pos;
+        if ('\0' == header[0]) break; // Нулевой блок - конец архива
+
+        // Контрольная сумма считается с пробелами на её месте
+        uint sum = 0;
+        for (int i = 0; i < tarBlock; ++i) sum += i >= 148 && i < 156 ? ' ' : static_cast<uchar>(header[i]);
+        if (sum != ParseOctal(header + 148, 8))
+        {
+            if (error) *error = "Broken tar header.";
+            return false;
+        }
+
+        const quint64 size = ParseOctal(header + 124, 12);
+        const char type = header[156];
+        pos += tarBlock;
+        if (size > static_cast<quint64>(data.size() - pos))
+        {
+            if (error) *error = "Truncated tar archive.";
+            return false;
+        }
+        const QByteArray content = data.mid(pos, static_cast<int>(size));
+        pos += static_cast<int>((size + tarBlock - 1) / tarBlock * tarBlock);
+
+        if ('L' == type) // GNU: длинное имя следующего члена
+        {
+            longName = Field(content.constData(), content.size());
+        }
+        else if ('x' == type)
+        {
+            longName = PaxPath(content);
+        }
+        else if ('0' == type || '\0' == type || '7' == type)
+        {
+            QByteArray name = longName;
+            if (name.isEmpty())
+            {
+                name = Field(header, 100);
+                const QByteArray prefix = 0 == memcmp(header + 257, "ustar", 5) ? Field(header + 345, 155) : QByteArray();
+                if (!prefix.isEmpty()) name = prefix + '/' + name;
+            }
+            members.append({QString::fromUtf8(name), content});
+            longName.clear();
+        }
+        else
+        {
+            longName.clear();
+        }
+    }
+
+    return true;
+}
+
+void PutOctal(char* field, const int len, const quint64 value)
+{
+    const QByteArray digits = QByteArray::number(value, 8).rightJustified(len - 1, '0');
+    memcpy(field, digits.constData(), static_cast<size_t>(len - 1));
+    field[len - 1] = '\0';
+}
+
+QByteArray TarHeader(const QByteArray& name, const quint64 size, const char type)
+{
+    QByteArray header(tarBlock, '\0');
+    char* const h = header.data();
+    memcpy(h, name.constData(), static_cast<size_t>(qMin(name.size(), 100)));
+    PutOctal(h + 100, 8, 0644);
+    PutOctal(h + 108, 8, 0);
+    PutOctal(h + 116, 8, 0);
+    PutOctal(h + 124, 12, size);
+    PutOctal(h + 136, 12, 0);
+    h[156] = type;
+    memcpy(h + 257, "ustar\0" "00", 8);
+
+    memset(h + 148, ' ', 8);
+    uint sum = 0;
+    for (int i = 0; i < tarBlock; ++i) sum += static_cast<uchar>(h[i]);
+    PutOctal(h + 148, 7, sum);
+    h[155] = ' ';
+    return header;
+}
+
+void AppendPadded(QByteArray& out, const QByteArray& data)
+{
+    out.append(data);
+    out.append(QByteArray((tarBlock - data.size() % tarBlock) % tarBlock, '\0'));
+}
+
+//
+// zip
+//
+const quint32 zipLocal   = 0x04034B50;
+const quint32 zipCentral = 0x02014B50;
+const quint32 zipEnd     = 0x06054B50;
+
+quint16 Get16(const QByteArray& data, const int pos)
+{
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(data.constData() + pos));
+}
+
+quint32 Get32(const QByteArray& data, const int pos)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData() + pos));
+}
+
+void Put16(QByteArray& out, const quint16 value)
+{
+    uchar buffer[2];
+    qToLittleEndian(value, buffer);
+    out.append(reinterpret_cast<const char*>(buffer), 2);
+}
+
+void Put32(QByteArray& out, const quint32 value)
+{
+    uchar buffer[4];
+    qToLittleEndian(value, buffer);
+    out.append(reinterpret_cast<const char*>(buffer), 4);
+}
+
+bool InflateRaw(const QByteArray& in, const int size, QByteArray& out)
+{
+    out = QByteArray(size, Qt::Uninitialized);
+    z_stream zs = {};
+    if (Z_OK != inflateInit2(&zs, -MAX_WBITS)) return false;
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.constData()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    const int ret = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    return Z_STREAM_END == ret && 0 == zs.avail_out;
+}
+
+QByteArray DeflateRaw(const QByteArray& in)
+{
+    z_stream zs = {};
+    if (Z_OK != deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY)) return QByteArray();
+
+    QByteArray out(static_cast<int>(deflateBound(&zs, static_cast<uLong>(in.size()))), Qt::Uninitialized);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.constData()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    const int ret = deflate(&zs, Z_FINISH);
+    out.resize(out.size() - static_cast<int>(zs.avail_out));
+    deflateEnd(&zs);
+    return Z_STREAM_END == ret ? out : QByteArray();
+}
+
+quint32 Crc32(const QByteArray& data)
+{
+    return static_cast<quint32>( crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef*>(data.constData()), static_cast<uInt>(data.size())) );
+}
+
+// Члены берутся из центрального каталога: размеры в локальных заголовках
+// могут быть нулевыми при записи с дескриптором данных
+bool ReadZip(const QByteArray& data, QList<Member>& members, QString* error)
+{
+    int end = -1;
+    for (int pos = data.size() - 22; pos >= 0 && pos >= data.size() - 22 - 0xFFFF; --pos)
+    {
+        if (zipEnd == Get32(data, pos))
+        {
+            end = pos;
+            break;
+        }
+    }
+    if (-1 == end)
+    {
+        if (error) *error = "Broken zip archive.";
+        return false;
+    }
+
+    const int count = Get16(data, end + 10);
+    int pos = static_cast<int>( qMin<quint32>(Get32(data, end + 16), static_cast<quint32>(data.size())) );
+    for (int i = 0; i < count; ++i)
+    {
+        if (pos + 46 > data.size() || zipCentral != Get32(data, pos))
+        {
+            if (error) *error = "Broken zip central directory.";
+            return false;
+        }
+
+        const quint16 flags  = Get16(data, pos + 8);
+        const quint16 method = Get16(data, pos + 10);
+        const quint32 crc    = Get32(data, pos + 16);
+        const quint32 packed = Get32(data, pos + 20);
+        const quint32 size   = Get32(data, pos + 24);
+        const int nameLength = Get16(data, pos + 28);
+        const quint32 local  = Get32(data, pos + 42);
+        const QByteArray rawName = data.mid(pos + 46, nameLength);
+        pos += 46 + nameLength + Get16(data, pos + 30) + Get16(data, pos + 32);
+
+        if ( rawName.endsWith('/') ) continue; // Каталог
+        const QString name = flags & 0x0800 ? QString::fromUtf8(rawName) : QString::fromLatin1(rawName);
+        if ((flags & 0x0001) || (0 != method && 8 != method) || 0xFFFFFFFF == packed || 0xFFFFFFFF == size || size > 0x7FFFFFFF)
+        {
+            if (error) *error = QString("Unsupported zip member \"%1\".").arg(name);
+            return false;
+        }
+
+        if (static_cast<qint64>(local) + 30 > data.size() || zipLocal != Get32(data, static_cast<int>(local)))
+        {
+            if (error) *error = QString("Broken zip member \"%1\".").arg(name);
+            return false;
+        }
+        const qint64 start = static_cast<qint64>(local) + 30 + Get16(data, static_cast<int>(local) + 26) + Get16(data, static_cast<int>(local) + 28);
+        if (start + packed > data.size())
+        {
+            if (error) *error = QString("Truncated zip member \"%1\".").arg(name);
+            return false;
+        }
+
+        QByteArray content = data.mid(static_cast<int>(start), static_cast<int>(packed));
+        bool ok = true;
+        if (8 == method)
+        {
+            const QByteArray packedData = content;
+            ok = InflateRaw(packedData, static_cast<int>(size), content);
+        }
+        if (!ok || Crc32(content) != crc)
+        {
+            if (error) *error = QString("Broken zip member \"%1\".").arg(name);
+            return false;
+        }
+        members.append({name, content});
+    }
+
+    return true;
+}
+}
+
+Format FromMagic(const QByteArray& data)
+{
+    if ( data.startsWith("PK\x03\x04") || data.startsWith("PK\x05\x06") ) return ARC_ZIP;
+    if ( data.size() >= tarBlock && 0 == memcmp(data.constData() + 257, "ustar", 5) ) return ARC_TAR;
+    return ARC_NONE;
+}
+
+Format FromFileName(const QString& fileName)
+{
+    const QString lower = fileName.toLower();
+    if ( lower.endsWith(".zip") ) return ARC_ZIP;
+    if ( lower.endsWith(".tar") || lower.endsWith(".tar.gz") || lower.endsWith(".tar.zst") ) return ARC_TAR;
+    return ARC_NONE;
+}
+
+bool Read(const QByteArray& data, QList<Member>& members, QString* error)
+{
+    members.clear();
+    switch ( FromMagic(data) )
+    {
+    case ARC_TAR:
+        return ReadTar(data, members, error);
+
+    case ARC_ZIP:
+        return ReadZip(data, members, error);
+
+    default:
+        if (error) *error = "Not a tar or zip archive.";
+        return false;
+    }
+}
+
+QByteArray WriteTar(const QList<Member>& members)
+{
+    QByteArray out;
+    for (const Member& member : members)
+    {
+        const QByteArray name = member.name.toUtf8();
+        if (name.size() > 100)
+        {
+            AppendPadded(out, TarHeader("././@LongLink", static_cast<quint64>(name.size() + 1), 'L'));
+            AppendPadded(out, name + '\0');
+        }
+        out.append( TarHeader(name, static_cast<quint64>(member.data.size()), '0') );
+        AppendPadded(out, member.data);
+    }
+    out.append(QByteArray(2 * tarBlock, '\0'));
+    return out;
+}
+
+QByteArray WriteZip(const QList<Member>& members)
+{
+    QByteArray out, central;
+    for (const Member& member : members)
+    {
+        const QByteArray name = member.name.toUtf8();
+        const quint32 crc = Crc32(member.data);
+        const QByteArray deflated = DeflateRaw(member.data);
+        const bool deflate = !deflated.isEmpty() && deflated.size() < member.data.size();
+        const QByteArray& stored = deflate ? deflated : member.data;
+        const quint32 offset = static_cast<quint32>(out.size());
+
+        // Общая часть локального и центрального заголовков, начиная с версии
+        QByteArray common;
+        Put16(common, 20);                      // Версия для распаковки
+        Put16(common, 0x0800);                  // Имя в UTF-8
+        Put16(common, deflate ? 8 : 0);
+        Put16(common, 0);                       // Время
+        Put16(common, 0x21);                    // Дата: 1980-01-01
+        Put32(common, crc);
+        Put32(common, static_cast<quint32>(stored.size()));
+        Put32(common, static_cast<quint32>(member.data.size()));
+        Put16(common, static_cast<quint16>(name.size()));
+        Put16(common, 0);                       // Дополнительное поле
+
+        Put32(out, zipLocal);
+        out.append(common);
+        out.append(name);
+        out.append(stored);
+
+        Put32(central, zipCentral);
+        Put16(central, 20);                     // Версия создателя
+        central.append(common);
+        Put16(central, 0);                      // Комментарий
+        Put16(central, 0);                      // Номер диска
+        Put16(central, 0);                      // Внутренние атрибуты
+        Put32(central, 0);                      // Внешние атрибуты
+        Put32(central, offset);
+        central.append(name);
+    }
+
+    const quint32 centralOffset = static_cast<quint32>(out.size());
+    out.append(central);
+    Put32(out, zipEnd);
+    Put16(out, 0);
+    Put16(out, 0);
+    Put16(out, static_cast<quint16>(members.length()));
+    Put16(out, static_cast<quint16>(members.length()));
+    Put32(out, static_cast<quint32>(central.size()));
+    Put32(out, centralOffset);
+    Put16(out, 0);
+    return out;
+}
+}
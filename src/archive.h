@@ -0,0 +1,46 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+// Архивы tar и zip в памяти: чтение членов без распаковки на диск и запись обратно.
+// zip поддерживается без шифрования и ZIP64, методы stored и deflate.
+namespace Archive
+{
+enum Format {ARC_NONE, ARC_TAR, ARC_ZIP};
+
+struct Member
+{
+    QString    name;    // Путь внутри архива, через '/'
+    QByteArray data;
+};
+
+Format FromMagic(const QByteArray& data);
+Format FromFileName(const QString& fileName);
+
+bool Read(const QByteArray& data, QList<Member>& members, QString* error = nullptr);
+QByteArray WriteTar(const QList<Member>& members);
+QByteArray WriteZip(const QList<Member>& members);
+}
+
+#endif // ARCHIVE_H
@@ -17,125 +17,630 @@
  */
 
 #include "cleaner.h"
-#include "script.h"
+#include "compression.h"
+#include "snapshot.h"
+#include "matroska.h"
+#include "archive.h"
+#include "encoding.h"
+#include "trace.h"
 #include <QCoreApplication>
-#include <QTextCodec>
-#include <QSet>
+#include <QFileInfo>
+#include <QDir>
+#include <QtConcurrent>
+#include <QThreadPool>
 
-Cleaner::Cleaner(QObject *parent, const QString &inputFile, const QString &outputFile, const Options flags) :
+namespace
+{
+// Генерация одного вывода; скрипт только читается, поэтому общий для всех потоков
+struct GenerateFunctor
+{
+    typedef QByteArray result_type;
+
+    const Engine* engine;
+    const Script::Script* script;
+
+    QByteArray operator()(const Script::ScriptType type) const
+    {
+        QByteArray data;
+        engine->generate(*script, type, data);
+        return data;
+    }
+};
+
+// Блок событий чистится как отдельный скрипт из одной секции
+bool CleanBlock(const Engine& engine, const QStringList& lines, const Script::ScriptType type, QByteArray& data)
+{
+    Trace::Span span("clean block");
+    const QByteArray text = QString("[%1]\n").arg(Script::Sections::events).toUtf8() + lines.join('\n').toUtf8();
+
+    Script::Script script;
+    QByteArray head, tail;
+    QByteArrayList events;
+    if ( !Script::ParseSSA(text, script) || !engine.clean(script, type) ||
+         !engine.generateParts(script, type, head, events, tail) ) return false;
+
+    data = events.join();
+    return true;
+}
+}
+
+Cleaner::Cleaner(QObject *parent, const QString &inputFile, const QList<Output> &outputs, const Engine &engine) :
     QObject(parent),
     _inputFile(inputFile),
-    _outputFile(outputFile),
-    _flags(flags)
+    _outputs(outputs),
+    _engine(engine),
+    _verify(false)
 {}
 
-void Cleaner::run()
+void Cleaner::setIncremental(const QByteArray &key, const bool verify)
 {
-    // Read input file
-    if ( !_inputFile.open(QFile::ReadOnly | QFile::Text) )
+    _incrementalKey = key;
+    _verify = verify;
+}
+
+void Cleaner::printStats(const Engine::Stats &stats) const
+{
+    if (!_engine.flags().testFlag(Engine::ShowStats)) return;
+
+    for (const QPair<QString, QString>& stat : stats)
     {
-        fprintf(stderr, "%s\n", qPrintable(QString("Can't read file \"%1\".").arg(_inputFile.fileName())));
-        QCoreApplication::exit(EXIT_FAILURE);
-        return;
+        fprintf(stderr, "%s\n", qPrintable(QString("%1: %2").arg(stat.first, stat.second)));
     }
+}
 
-    QTextStream inputStream(&_inputFile);
-    const Script::ScriptType scriptType = Script::DetectFormat(inputStream);
-    Script::Script script;
-    switch (scriptType)
+bool Cleaner::readSnapshot(Script::Script &script, Script::ScriptType &scriptType)
+{
+    // Pre-parsed snapshot, mapped into memory
+    Trace::Span span("load snapshot");
+    const bool loadOk = Snapshot::Load(_inputFile, script, scriptType);
+    _inputFile.close();
+    if (!loadOk)
     {
-    case Script::SCR_SSA:
-    case Script::SCR_ASS:
-        if ( !Script::ParseSSA(inputStream, script) )
+        fprintf(stderr, "%s\n", qPrintable(QString("\"%1\" is a broken snapshot.").arg(_inputFile.fileName())));
+        return false;
+    }
+    return true;
+}
+
+bool Cleaner::parseInput(const QByteArray &data, Script::Script &script, Script::ScriptType &scriptType)
+{
+    Engine::Stats stats;
+    QString error;
+    const bool parseOk = _engine.parse(data, script, scriptType, &stats, &error);
+    this->printStats(stats);
+    if (!parseOk)
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("\"%1\": %2").arg(_inputFile.fileName(), error)));
+        return false;
+    }
+
+    return true;
+}
+
+// Формат вывода: явно указанный, по расширению (без .gz/.zst), иначе как у входного файла
+Script::ScriptType Cleaner::outputType(const Output &output, const Script::ScriptType inputType)
+{
+    if (Script::SCR_UNKNOWN != output.type) return output.type;
+
+    QString fileName = QFileInfo(output.fileName).fileName();
+    if (Compression::CMP_NONE != Compression::FromFileName(fileName))
+    {
+        fileName.truncate( fileName.lastIndexOf('.') );
+    }
+
+    const Script::ScriptType type = Script::FormatFromSuffix( QFileInfo(fileName).suffix() );
+    return Script::SCR_UNKNOWN != type ? type : inputType;
+}
+
+bool Cleaner::writeSnapshot(const QString &fileName, const Script::Script &script, const Script::ScriptType scriptType)
+{
+    Trace::Span span("write", fileName);
+    QFile file(fileName);
+    if ( !file.open(QFile::WriteOnly) || !Snapshot::Save(&file, script, scriptType) )
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("Can't write file \"%1\".").arg(fileName)));
+        return false;
+    }
+
+    file.close();
+    return true;
+}
+
+// Пути с ".." и абсолютные не пропускаем, чтобы архив не писал за пределы каталога
+bool Cleaner::writeDirectory(const QString &dirName, const QList<Archive::Member> &members)
+{
+    const QDir dir(dirName);
+    for (const Archive::Member& member : members)
+    {
+        const QString path = QDir::cleanPath(member.name);
+        if (QDir::isAbsolutePath(path) || ".." == path || path.startsWith("../") || path.contains(':'))
         {
-            _inputFile.close();
-            fprintf(stderr, "%s\n", qPrintable(QString("\"%1\" isn't an SSA/ASS file.").arg(_inputFile.fileName())));
-            QCoreApplication::exit(EXIT_FAILURE);
-            return;
+            fprintf(stderr, "%s\n", qPrintable(QString("Skipped unsafe archive member \"%1\".").arg(member.name)));
+            continue;
         }
-        break;
 
-    default:
-        _inputFile.close();
-        fprintf(stderr, "%s\n", qPrintable(QString("\"%1\" file format is unknown.").arg(_inputFile.fileName())));
-        QCoreApplication::exit(EXIT_FAILURE);
-        return;
+        const QString fileName = dir.filePath(path);
+        if ( !QDir().mkpath(QFileInfo(fileName).path()) || !writeOutput(fileName, member.data, false) ) return false;
+    }
+
+    return true;
+}
+
+bool Cleaner::writeOutput(const QString &fileName, const QByteArray &data, const bool text)
+{
+    const Compression::Format compression = Compression::FromFileName(fileName);
+    const QIODevice::OpenMode openMode = text && Compression::CMP_NONE == compression ? QFile::WriteOnly | QFile::Text : QFile::WriteOnly;
+
+    Trace::Span span("write", fileName);
+    QFile file(fileName);
+    if ( !file.open(openMode) || !Compression::WriteFile(file, data, compression) )
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("Can't write file \"%1\".").arg(fileName)));
+        return false;
+    }
+
+    file.close();
+    return true;
+}
+
+// Генерация идёт в вызывающем потоке, сжатие и диск - в потоке Compression::Writer
+bool Cleaner::writeCompressed(const QString &fileName, const Script::Script &script, const Script::ScriptType scriptType) const
+{
+    Trace::Span span("write", fileName);
+    QFile file(fileName);
+    Compression::Writer writer(&file, Compression::FromFileName(fileName));
+    bool ok = file.open(QFile::WriteOnly) && writer.open(QIODevice::WriteOnly);
+    if (ok)
+    {
+        ok = _engine.generate(script, scriptType, writer);
+        writer.close();
+        ok = ok && writer.isOk();
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("Can't write file \"%1\".").arg(fileName)));
+        return false;
+    }
+
+    file.close();
+    return true;
+}
+
+// Вывод склеивается из частей, рядом пишется индекс для следующего запуска
+bool Cleaner::writeIncremental(const QString &fileName, const QByteArray &key, const QByteArray &input, const Incremental::Layout &layout,
+                               const QByteArray &head, const QList<QByteArray> &blocks, const QByteArray &tail) const
+{
+    Incremental::Index index;
+    index.key = key;
+    index.restHash = layout.restHash;
+    index.headSize = head.size();
+    index.tailSize = tail.size();
+
+    QByteArray data = head;
+    for (int i = 0; i < blocks.length(); ++i)
+    {
+        data.append(blocks.at(i));
+        index.blockHashes.append(layout.blocks.at(i).hash);
+        index.blockSizes.append(blocks.at(i).size());
+    }
+    data.append(tail);
+    index.outputHash = Incremental::Hash(data);
+
+    // Склеенный вывод должен совпадать с полной очисткой байт в байт
+    if (_verify)
+    {
+        Trace::Span span("verify");
+        Engine engine(_engine);
+        engine.setFontDir(QString());
+
+        QByteArray full;
+        QString error;
+        if ( !engine.process(input, full, nullptr, &error) )
+        {
+            fprintf(stderr, "%s\n", qPrintable(error));
+            return false;
+        }
+        if (full != data)
+        {
+            fprintf(stderr, "%s\n", qPrintable(QString("\"%1\": Incremental output differs from a full run.").arg(fileName)));
+            return false;
+        }
+    }
+
+    // Старый индекс удаляем заранее: прерванная запись не должна оставить его рядом с новым выводом
+    const QString indexName = fileName + Incremental::suffix;
+    QFile::remove(indexName);
+    if ( !writeOutput(fileName, data) ) return false;
+    if ( !Incremental::Save(indexName, index) )
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("Can't write file \"%1\".").arg(indexName)));
+        return false;
+    }
+
+    return true;
+}
+
+// <каталог>/<имя>.track<N>.<формат>; без явного формата - ASS
+Cleaner::Output Cleaner::trackOutput(const Output &output, const quint64 number)
+{
+    const QFileInfo fileInfo(output.fileName);
+    const Script::ScriptType type = outputType(output, Script::SCR_ASS);
+    const QString suffix = Script::SCR_SRT == type ? "srt" : Script::SCR_SSA == type ? "ssa" : "ass";
+    return {fileInfo.dir().filePath(QString("%1.track%2.%3").arg(fileInfo.completeBaseName()).arg(number).arg(suffix)), type};
+}
+
+bool Cleaner::processScript(Script::Script &script, const Script::ScriptType scriptType, const QList<Output> &outputs)
+{
+    // Output formats; times are rounded for the coarsest one
+    QList<Script::ScriptType> types;
+    Script::ScriptType cleanType = Script::SCR_SRT;
+    for (const Output& output : outputs)
+    {
+        const Script::ScriptType type = output.fileName.endsWith(Snapshot::suffix) ? scriptType : outputType(output, scriptType);
+        types.append(type);
+        if (Script::SCR_SSA == type || Script::SCR_ASS == type) cleanType = type;
+    }
+
+    // Clean
+    Engine::Stats stats;
+    QString error;
+    const bool cleanOk = _engine.clean(script, cleanType, &stats, &error);
+    this->printStats(stats);
+    if (!cleanOk)
+    {
+        fprintf(stderr, "%s\n", qPrintable(error));
+        return false;
+    }
+
+    // Generate plain text outputs concurrently from the same script;
+    // compressed ones are generated while writing, overlapped with compression
+    QList<Script::ScriptType> textTypes;
+    for (int i = 0; i < outputs.length(); ++i)
+    {
+        const QString& fileName = outputs.at(i).fileName;
+        if ( !fileName.endsWith(Snapshot::suffix) && Compression::CMP_NONE == Compression::FromFileName(fileName) )
+        {
+            textTypes.append(types.at(i));
+        }
+    }
+    const QList<QByteArray> generated = QtConcurrent::blockingMapped(textTypes, GenerateFunctor{&_engine, &script});
+
+    // Write output files
+    for (int i = 0, text = 0; i < outputs.length(); ++i)
+    {
+        const QString& fileName = outputs.at(i).fileName;
+        bool writeOk;
+        if ( fileName.endsWith(Snapshot::suffix) )
+        {
+            writeOk = writeSnapshot(fileName, script, types.at(i));
+        }
+        else if (Compression::CMP_NONE != Compression::FromFileName(fileName))
+        {
+            writeOk = writeCompressed(fileName, script, types.at(i));
+        }
+        else
+        {
+            const QByteArray& data = generated.at(text++);
+            if (data.isEmpty())
+            {
+                fprintf(stderr, "%s\n", qPrintable(QString("Houston, we have a problem.")));
+                writeOk = false;
+            }
+            else
+            {
+                writeOk = writeOutput(fileName, data);
+            }
+        }
+
+        if (!writeOk) return false;
+    }
+
+    return true;
+}
+
+// Каждая текстовая дорожка - отдельный скрипт со своими файлами вывода
+bool Cleaner::processMatroska()
+{
+    QList<Matroska::Track> tracks;
+    QString error;
+    bool readOk;
+    {
+        Trace::Span span("read tracks", _inputFile.fileName());
+        readOk = Matroska::ReadTracks(_inputFile, tracks, &error);
     }
     _inputFile.close();
+    if (!readOk)
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("\"%1\": %2").arg(_inputFile.fileName(), error)));
+        return false;
+    }
+    if (tracks.isEmpty())
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("\"%1\" has no text subtitle tracks.").arg(_inputFile.fileName())));
+        return false;
+    }
+
+    for (const Matroska::Track& track : qAsConst(tracks))
+    {
+        Script::Script script;
+        Script::ScriptType scriptType;
+        Engine::Stats stats;
+        const bool parseOk = _engine.parse(track.script, script, scriptType, &stats, &error);
+        this->printStats(stats);
+        if (!parseOk)
+        {
+            fprintf(stderr, "%s\n", qPrintable(QString("\"%1\", track %2: %3").arg(_inputFile.fileName()).arg(track.number).arg(error)));
+            return false;
+        }
+
+        QList<Output> outputs;
+        for (const Output& output : _outputs) outputs.append( trackOutput(output, track.number) );
+        if ( !this->processScript(script, scriptType, outputs) ) return false;
+    }
+
+    return true;
+}
+
+// Субтитры из архива чистятся параллельно в собственном пуле: задачи самого
+// Engine (шрифты, сортировка) идут в глобальный и не ждут освобождения потоков.
+// Остальные члены архива переносятся без изменений.
+bool Cleaner::processArchive(const QByteArray &data)
+{
+    QList<Archive::Member> members;
+    QString error;
+    if ( !Archive::Read(data, members, &error) )
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("\"%1\": %2").arg(_inputFile.fileName(), error)));
+        return false;
+    }
+
+    QThreadPool pool;
+    QList<int> indexes;
+    QList< QFuture<QString> > results;
+    for (int i = 0; i < members.length(); ++i)
+    {
+        if ( Script::SCR_UNKNOWN == Script::FormatFromSuffix(QFileInfo(members.at(i).name).suffix()) ) continue;
+
+        Archive::Member* const member = &members[i];
+        indexes.append(i);
+        results.append( QtConcurrent::run(&pool, [this, member]() {
+            Trace::Span span("member", member->name);
+            QByteArray output;
+            QString error;
+            if ( !_engine.process(member->data, output, nullptr, &error) ) return error;
+            member->data = output;
+            return QString();
+        }) );
+    }
+
+    int failed = 0;
+    for (int i = 0; i < results.length(); ++i)
+    {
+        const QString memberError = results[i].result();
+        if (memberError.isEmpty()) continue;
+
+        fprintf(stderr, "%s\n", qPrintable(QString("\"%1\": %2").arg(members.at(indexes.at(i)).name, memberError)));
+        ++failed;
+    }
+    this->printStats({qMakePair(QString("Cleaned members"), QString::number(results.length() - failed)),
+                      qMakePair(QString("Failed members"), QString::number(failed))});
+
+    for (const Output& output : _outputs)
+    {
+        bool writeOk = true;
+        switch ( Archive::FromFileName(output.fileName) )
+        {
+        case Archive::ARC_TAR:
+            writeOk = writeOutput(output.fileName, Archive::WriteTar(members), false);
+            break;
+
+        case Archive::ARC_ZIP:
+            writeOk = writeOutput(output.fileName, Archive::WriteZip(members), false);
+            break;
+
+        default:
+            writeOk = writeDirectory(output.fileName, members);
+            break;
+        }
+        if (!writeOk) return false;
+    }
+
+    return 0 == failed;
+}
+
+// Один вывод SSA/ASS без сжатия. Если индекс подходит к входу и старый вывод
+// не тронут, чистятся только изменившиеся блоки событий; иначе - полный проход.
+bool Cleaner::processIncremental(const QByteArray &data)
+{
+    const Output& output = _outputs.first();
+
+    // Блоки режутся по тексту; формат виден по его началу
+    const QString text = Encoding::Decode(data);
+    const Script::ScriptType inputType = Script::DetectFormat( text.left(5120).toUtf8() );
+    const Script::ScriptType type = outputType(output, inputType);
 
-    // Strip comments
-    if (_flags.testFlag(StripComments))
+    Incremental::Layout layout;
+    if ( (Script::SCR_SSA != inputType && Script::SCR_ASS != inputType) ||
+         (Script::SCR_SSA != type && Script::SCR_ASS != type) ||
+         Compression::CMP_NONE != Compression::FromFileName(output.fileName) ||
+         !Incremental::Split(text, layout) )
     {
-        for (Script::Line::Named* const line : qAsConst(script.header.content)) {
-            line->clearBefore();
+        Script::Script script;
+        Script::ScriptType scriptType;
+        return this->parseInput(data, script, scriptType) && this->processScript(script, scriptType, _outputs);
+    }
+
+    const QByteArray key = _incrementalKey + QByteArray::number(inputType) + ':' + QByteArray::number(type);
+
+    // Previous output, checked against its index
+    Incremental::Index index;
+    QHash<QByteArray, QByteArray> reusable;
+    QByteArray previous;
+    QFile previousFile(output.fileName);
+    if ( Incremental::Load(output.fileName + Incremental::suffix, index) &&
+         key == index.key && layout.restHash == index.restHash &&
+         previousFile.open(QFile::ReadOnly | QFile::Text) )
+    {
+        previous = previousFile.readAll();
+        previousFile.close();
+
+        qint64 offset = index.headSize;
+        for (int i = 0; i < index.blockHashes.length(); ++i)
+        {
+            reusable.insert(index.blockHashes.at(i), previous.mid(static_cast<int>(offset), static_cast<int>(index.blockSizes.at(i))));
+            offset += index.blockSizes.at(i);
+        }
+
+        if (offset + index.tailSize != previous.size() || Incremental::Hash(previous) != index.outputHash)
+        {
+            reusable.clear();
+            previous.clear();
+        }
+    }
+
+    if (!previous.isEmpty())
+    {
+        // Clean changed blocks concurrently, in a private pool like archive members
+        Engine engine(_engine);
+        engine.setFontDir(QString());
+
+        QThreadPool pool;
+        QList<QByteArray> blocks;
+        QList<int> changed;
+        QList< QFuture<bool> > results;
+        for (const Incremental::Block& block : layout.blocks) blocks.append( reusable.value(block.hash) );
+        for (int i = 0; i < layout.blocks.length(); ++i)
+        {
+            if ( reusable.contains(layout.blocks.at(i).hash) ) continue;
+
+            QByteArray* const block = &blocks[i];
+            const QStringList* const lines = &layout.blocks.at(i).lines;
+            changed.append(i);
+            results.append( QtConcurrent::run(&pool, [&engine, lines, type, block]() {
+                return CleanBlock(engine, *lines, type, *block);
+            }) );
         }
-        script.header.clearAfter();
 
-        for (Script::Line::Style* const line : qAsConst(script.styles.content)) {
-            line->clearBefore();
+        bool cleanOk = true;
+        for (QFuture<bool>& result : results) cleanOk = result.result() && cleanOk;
+        if (!cleanOk)
+        {
+            fprintf(stderr, "%s\n", qPrintable(QString("\"%1\": Can't clean changed events.").arg(_inputFile.fileName())));
+            return false;
         }
-        script.styles.clearAfter();
 
-        for (Script::Line::Event* const line : qAsConst(script.events.content)) {
-            line->clearBefore();
+        this->printStats({qMakePair(QString("Reused blocks"), QString("%1 of %2").arg(layout.blocks.length() - changed.length()).arg(layout.blocks.length()))});
+        return writeIncremental(output.fileName, key, data, layout,
+                                previous.left(static_cast<int>(index.headSize)), blocks,
+                                previous.right(static_cast<int>(index.tailSize)));
+    }
+
+    // Full run: remember the block of every parsed event
+    Script::Script script;
+    Script::ScriptType scriptType;
+    if ( !this->parseInput(data, script, scriptType) ) return false;
+
+    QHash<const Script::Line::Event*, int> blockOf;
+    QList<Script::Line::Event*>::const_iterator it = script.events.content.constBegin();
+    for (int i = 0; i < layout.blocks.length(); ++i)
+    {
+        for (int j = 0; j < layout.blocks.at(i).events && it != script.events.content.constEnd(); ++j, ++it)
+        {
+            blockOf.insert(*it, i);
         }
-        script.events.clearAfter();
+    }
+    if ( it != script.events.content.constEnd() || blockOf.size() != script.events.content.length() )
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("Houston, we have a problem.")));
+        return false;
+    }
 
-        script.clearBefore();
-        script.clearAfter();
+    Engine::Stats stats;
+    QString error;
+    const bool cleanOk = _engine.clean(script, type, &stats, &error);
+    this->printStats(stats);
+    if (!cleanOk)
+    {
+        fprintf(stderr, "%s\n", qPrintable(error));
+        return false;
     }
 
-    // Strip info lines
-    if (_flags.testFlag(StripStyleInfo))
+    QByteArray head, tail;
+    QByteArrayList events;
+    if ( !_engine.generateParts(script, type, head, events, tail, &error) )
     {
-        // ScriptType добавляется всегда
-        const QSet<QString> importantLines = {
-            QString("WrapStyle").toLower(),
-            QString("PlayResX").toLower(),
-            QString("PlayResY").toLower(),
-            QString("ScaledBorderAndShadow").toLower(),
-            QString("YCbCr Matrix").toLower()
-        };
+        fprintf(stderr, "%s\n", qPrintable(error));
+        return false;
+    }
 
-        auto isUnimportant = [importantLines](const Script::Line::Named* const line) {
-            return !importantLines.contains(line->name().toLower());
-        };
-        script.header.content.erase(std::remove_if(script.header.content.begin(), script.header.content.end(), isUnimportant),
-                                    script.header.content.end());
+    QList<QByteArray> blocks;
+    for (int i = 0; i < layout.blocks.length(); ++i) blocks.append(QByteArray());
+    for (int i = 0; i < events.length(); ++i)
+    {
+        blocks[ blockOf.value(script.events.content.at(i)) ].append(events.at(i));
     }
 
-    // Strip fonts and graphics
-    script.fonts.clear();
-    script.graphics.clear();
+    return writeIncremental(output.fileName, key, data, layout, head, blocks, tail);
+}
 
-    // Write output file
-    if ( !_outputFile.open(QFile::WriteOnly | QFile::Text) )
+void Cleaner::run()
+{
+    if ( !_inputFile.open(QFile::ReadOnly) )
     {
-        fprintf(stderr, "%s\n", qPrintable(QString("Can't write file \"%1\".").arg(_inputFile.fileName())));
+        fprintf(stderr, "%s\n", qPrintable(QString("Can't read file \"%1\".").arg(_inputFile.fileName())));
         QCoreApplication::exit(EXIT_FAILURE);
         return;
     }
 
-    QTextStream outputStream(&_outputFile);
-    outputStream.setCodec( QTextCodec::codecForName("UTF-8") );
-    outputStream.setGenerateByteOrderMark(true);
-    switch (scriptType)
+    Trace::Span span("file", _inputFile.fileName());
+    bool ok;
+    Script::Script script;
+    Script::ScriptType scriptType;
+    const QByteArray head = _inputFile.peek(4);
+    if ( Matroska::IsMatroska(head) )
     {
-    case Script::SCR_SSA:
-        Script::GenerateSSA(outputStream, script);
-        break;
-
-    case Script::SCR_ASS:
-        Script::GenerateASS(outputStream, script);
-        break;
+        ok = this->processMatroska();
+    }
+    else if ( Snapshot::IsSnapshot(head) )
+    {
+        ok = this->readSnapshot(script, scriptType) && this->processScript(script, scriptType, _outputs);
+    }
+    else
+    {
+        QByteArray data;
+        bool readOk;
+        {
+            Trace::Span span("read", _inputFile.fileName());
+            readOk = Compression::ReadFile(_inputFile, data);
+        }
+        _inputFile.close();
+        if (!readOk)
+        {
+            fprintf(stderr, "%s\n", qPrintable(QString("Can't read file \"%1\".").arg(_inputFile.fileName())));
+            ok = false;
+        }
+        else if (Archive::ARC_NONE != Archive::FromMagic(data))
+        {
+            ok = this->processArchive(data);
+        }
+        else if ( !_incrementalKey.isEmpty() && 1 == _outputs.length() &&
+                  !_outputs.first().fileName.endsWith(Snapshot::suffix) &&
+                  !_engine.flags().testFlag(Engine::SortEvents) )
+        {
+            ok = this->processIncremental(data);
+        }
+        else
+        {
+            ok = this->parseInput(data, script, scriptType) && this->processScript(script, scriptType, _outputs);
+        }
+    }
 
-    default:
-        _outputFile.close();
-        fprintf(stderr, "%s\n", qPrintable(QString("Houston, we have a problem.").arg(_inputFile.fileName())));
+    if (!ok)
+    {
         QCoreApplication::exit(EXIT_FAILURE);
         return;
     }
-    _outputFile.close();
 
     emit finished();
 }
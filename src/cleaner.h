@@ -21,19 +21,28 @@
 
 #include <QObject>
 #include <QFile>
+#include "engine.h"
+#include "archive.h"
+#include "incremental.h"
 
+// Консольная обёртка над Engine: файлы, сжатие, снимки и статистика
 class Cleaner : public QObject
 {
     Q_OBJECT
 
 public:
-    enum Option {
-        StripComments  = 1 << 0,
-        StripStyleInfo = 1 << 1
+    // Цель вывода; SCR_UNKNOWN - формат по расширению файла
+    struct Output
+    {
+        QString fileName;
+        Script::ScriptType type;
     };
-    Q_DECLARE_FLAGS(Options, Option)
 
-    explicit Cleaner(QObject *parent, const QString &inputFile, const QString &outputFile, const Options flags = Options());
+    explicit Cleaner(QObject *parent, const QString &inputFile, const QList<Output> &outputs, const Engine &engine);
+
+    // Инкрементальный режим; key - отпечаток параметров запуска,
+    // verify - сверять склеенный вывод с полной очисткой
+    void setIncremental(const QByteArray &key, const bool verify = false);
 
 signals:
     void finished();
@@ -43,9 +52,27 @@ public slots:
 
 private:
     QFile _inputFile;
-    QFile _outputFile;
-    Options _flags;
+    const QList<Output> _outputs;
+    const Engine _engine;
+    QByteArray _incrementalKey;
+    bool _verify;
+
+    void printStats(const Engine::Stats &stats) const;
+    bool readSnapshot(Script::Script &script, Script::ScriptType &scriptType);
+    bool parseInput(const QByteArray &data, Script::Script &script, Script::ScriptType &scriptType);
+    bool processScript(Script::Script &script, const Script::ScriptType scriptType, const QList<Output> &outputs);
+    bool processMatroska();
+    bool processArchive(const QByteArray &data);
+    bool processIncremental(const QByteArray &data);
+
+    static Output trackOutput(const Output &output, const quint64 number);
+    static Script::ScriptType outputType(const Output &output, const Script::ScriptType inputType);
+    static bool writeSnapshot(const QString &fileName, const Script::Script &script, const Script::ScriptType scriptType);
+    static bool writeDirectory(const QString &dirName, const QList<Archive::Member> &members);
+    static bool writeOutput(const QString &fileName, const QByteArray &data, const bool text = true);
+    bool writeCompressed(const QString &fileName, const Script::Script &script, const Script::ScriptType scriptType) const;
+    bool writeIncremental(const QString &fileName, const QByteArray &key, const QByteArray &input, const Incremental::Layout &layout,
+                          const QByteArray &head, const QList<QByteArray> &blocks, const QByteArray &tail) const;
 };
-Q_DECLARE_OPERATORS_FOR_FLAGS(Cleaner::Options)
 
 #endif // CLEANER_H
@@ -0,0 +1,318 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "compression.h"
+#include <QFile>
+#include <QThread>
+#include <zlib.h>
+#include <zstd.h>
+
+namespace Compression
+{
+namespace
+{
+const int chunkSize = 256 * 1024;
+const int queueCapacity = 8;
+
+bool WriteBuffer(QFile& file, const QByteArray& buffer, const qint64 size)
+{
+    return !size || file.write(buffer.constData(), size) == size;
+}
+
+bool Inflate(const QByteArray& packed, QByteArray& data)
+{
+    z_stream zs = {};
+    if (Z_OK != inflateInit2(&zs, 15 + 32)) return false;
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(packed.constData()));
+    zs.avail_in = static_cast<uInt>(packed.size());
+
+    QByteArray buffer(chunkSize, Qt::Uninitialized);
+    int ret = Z_OK;
+    for (;;)
+    {
+        // Несколько склеенных gzip-потоков
+        if (Z_STREAM_END == ret)
+        {
+            if (!zs.avail_in) break;
+            inflateReset(&zs);
+        }
+
+        zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+        zs.avail_out = static_cast<uInt>(buffer.size());
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if (Z_OK != ret && Z_STREAM_END != ret) break;
+
+        data.append(buffer.constData(), buffer.size() - static_cast<int>(zs.avail_out));
+    }
+
+    inflateEnd(&zs);
+    return Z_STREAM_END == ret;
+}
+
+// Очередь выбирается до конца даже после ошибки, иначе генератор зависнет
+bool Deflate(ChunkQueue& queue, QFile& file)
+{
+    z_stream zs = {};
+    bool ok = Z_OK == deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    QByteArray buffer(chunkSize, Qt::Uninitialized);
+
+    for (QByteArray chunk = queue.pop(); ; chunk = queue.pop())
+    {
+        const bool last = chunk.isEmpty();
+        if (ok)
+        {
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(chunk.constData()));
+            zs.avail_in = static_cast<uInt>(chunk.size());
+            int ret;
+            do
+            {
+                zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+                zs.avail_out = static_cast<uInt>(buffer.size());
+                ret = deflate(&zs, last ? Z_FINISH : Z_NO_FLUSH);
+                ok = Z_STREAM_ERROR != ret && WriteBuffer(file, buffer, buffer.size() - static_cast<int>(zs.avail_out));
+            }
+            while (ok && (last ? Z_STREAM_END != ret : 0 == zs.avail_out));
+        }
+        if (last) break;
+    }
+
+    deflateEnd(&zs);
+    return ok;
+}
+
+bool ZstdDecompress(const QByteArray& packed, QByteArray& data)
+{
+    ZSTD_DStream* const ds = ZSTD_createDStream();
+    if ( !ds || ZSTD_isError(ZSTD_initDStream(ds)) )
+    {
+        ZSTD_freeDStream(ds);
+        return false;
+    }
+
+    QByteArray buffer(chunkSize, Qt::Uninitialized);
+    ZSTD_inBuffer in = {packed.constData(), static_cast<size_t>(packed.size()), 0};
+    ZSTD_outBuffer out;
+    size_t last;
+    bool ok;
+    do
+    {
+        out = {buffer.data(), static_cast<size_t>(buffer.size()), 0};
+        last = ZSTD_decompressStream(ds, &out, &in);
+        ok = !ZSTD_isError(last);
+        if (ok) data.append(buffer.constData(), static_cast<int>(out.pos));
+    }
+    while (ok && (in.pos < in.size || out.pos == out.size));
+
+    ZSTD_freeDStream(ds);
+    return ok && 0 == last;
+}
+
+bool ZstdCompress(ChunkQueue& queue, QFile& file)
+{
+    ZSTD_CStream* const cs = ZSTD_createCStream();
+    bool ok = cs && !ZSTD_isError( ZSTD_initCStream(cs, 3) );
+    QByteArray buffer(chunkSize, Qt::Uninitialized);
+
+    for (QByteArray chunk = queue.pop(); ; chunk = queue.pop())
+    {
+        const bool last = chunk.isEmpty();
+        ZSTD_inBuffer in = {chunk.constData(), static_cast<size_t>(chunk.size()), 0};
+        while (ok && in.pos < in.size)
+        {
+            ZSTD_outBuffer out = {buffer.data(), static_cast<size_t>(buffer.size()), 0};
+            ok = !ZSTD_isError( ZSTD_compressStream(cs, &out, &in) ) && WriteBuffer(file, buffer, static_cast<qint64>(out.pos));
+        }
+
+        size_t remaining = last ? 1 : 0;
+        while (ok && remaining)
+        {
+            ZSTD_outBuffer out = {buffer.data(), static_cast<size_t>(buffer.size()), 0};
+            remaining = ZSTD_endStream(cs, &out);
+            ok = !ZSTD_isError(remaining) && WriteBuffer(file, buffer, static_cast<qint64>(out.pos));
+        }
+        if (last) break;
+    }
+
+    ZSTD_freeCStream(cs);
+    return ok;
+}
+}
+
+// Свой поток, а не общий пул: вызывающий может сам работать в пуле
+// и ждать очередь, пока пул занят
+class CompressThread : public QThread
+{
+public:
+    CompressThread(QFile* file, const Format format, ChunkQueue* queue) :
+        ok(false),
+        _file(file),
+        _format(format),
+        _queue(queue)
+    {}
+
+    bool ok;
+
+protected:
+    void run() override
+    {
+        ok = CMP_GZIP == _format ? Deflate(*_queue, *_file) : ZstdCompress(*_queue, *_file);
+    }
+
+private:
+    QFile* const       _file;
+    const Format       _format;
+    ChunkQueue* const  _queue;
+};
+
+Format FromFileName(const QString& fileName)
+{
+    if ( fileName.endsWith(".gz", Qt::CaseInsensitive) )  return CMP_GZIP;
+    if ( fileName.endsWith(".zst", Qt::CaseInsensitive) ) return CMP_ZSTD;
+    return CMP_NONE;
+}
+
+Format FromMagic(const QByteArray& head)
+{
+    if ( head.startsWith("\x1F\x8B") )         return CMP_GZIP;
+    if ( head.startsWith("\x28\xB5\x2F\xFD") ) return CMP_ZSTD;
+    return CMP_NONE;
+}
+
+bool ReadFile(QFile& file, QByteArray& data)
+{
+    const Format format = FromMagic( file.peek(4) );
+    if (CMP_NONE == format)
+    {
+        data = file.readAll();
+        return QFile::NoError == file.error();
+    }
+
+    const QByteArray packed = file.readAll();
+    if (QFile::NoError != file.error()) return false;
+
+    data.clear();
+    return CMP_GZIP == format ? Inflate(packed, data) : ZstdDecompress(packed, data);
+}
+
+bool WriteFile(QFile& file, const QByteArray& data, const Format format)
+{
+    if (CMP_NONE == format) return file.write(data) == data.size();
+
+    Writer writer(&file, format);
+    if ( !writer.open(QIODevice::WriteOnly) ) return false;
+    writer.write(data);
+    writer.close();
+    return writer.isOk();
+}
+
+//
+// Ограниченная очередь
+//
+ChunkQueue::ChunkQueue(const int capacity) :
+    _capacity(capacity)
+{}
+
+void ChunkQueue::push(const QByteArray& chunk)
+{
+    QMutexLocker locker(&_mutex);
+    while (_chunks.length() >= _capacity) _notFull.wait(&_mutex);
+    _chunks.enqueue(chunk);
+    _notEmpty.wakeOne();
+}
+
+QByteArray ChunkQueue::pop()
+{
+    QMutexLocker locker(&_mutex);
+    while (_chunks.isEmpty()) _notEmpty.wait(&_mutex);
+    const QByteArray chunk = _chunks.dequeue();
+    _notFull.wakeOne();
+    return chunk;
+}
+
+//
+// Сжимающая запись
+//
+Writer::Writer(QFile* file, const Format format) :
+    _file(file),
+    _format(format),
+    _queue(queueCapacity),
+    _thread(nullptr),
+    _ok(false)
+{}
+
+Writer::~Writer()
+{
+    this->close();
+}
+
+bool Writer::open(OpenMode mode)
+{
+    if (CMP_NONE == _format || mode != QIODevice::WriteOnly || this->isOpen()) return false;
+
+    _ok = false;
+    _pending.clear();
+    _thread = new CompressThread(_file, _format, &_queue);
+    _thread->start();
+    return QIODevice::open(mode);
+}
+
+void Writer::close()
+{
+    if (!_thread) return;
+
+    if (!_pending.isEmpty()) _queue.push(_pending);
+    _pending.clear();
+    _queue.push(QByteArray());
+    _thread->wait();
+    _ok = _thread->ok;
+    delete _thread;
+    _thread = nullptr;
+
+    QIODevice::close();
+}
+
+bool Writer::isSequential() const
+{
+    return true;
+}
+
+bool Writer::isOk() const
+{
+    return _ok;
+}
+
+qint64 Writer::readData(char* data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+// Мелкие записи копятся до целого куска
+qint64 Writer::writeData(const char* data, qint64 maxSize)
+{
+    _pending.append(data, static_cast<int>(maxSize));
+    if (_pending.size() >= chunkSize)
+    {
+        _queue.push(_pending);
+        _pending.clear();
+    }
+    return maxSize;
+}
+}
@@ -0,0 +1,94 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+
+class QFile;
+
+// Сжатые файлы (.gz, .zst).
+// Чтение распаковывает файл целиком в вызывающем потоке: разбору нужен весь текст.
+// Запись сжимает и пишет на диск в собственном потоке, пока вызывающий
+// генерирует следующие куски; между ними - ограниченная очередь.
+namespace Compression
+{
+enum Format {CMP_NONE, CMP_GZIP, CMP_ZSTD};
+
+Format FromFileName(const QString& fileName);
+Format FromMagic(const QByteArray& head);
+
+// Читает файл целиком, распаковывая при необходимости
+bool ReadFile(QFile& file, QByteArray& data);
+// Пишет данные, сжимая в указанном формате
+bool WriteFile(QFile& file, const QByteArray& data, const Format format);
+
+// Ограниченная очередь; пустой кусок означает конец потока
+class ChunkQueue
+{
+public:
+    explicit ChunkQueue(const int capacity);
+
+    void push(const QByteArray& chunk);
+    QByteArray pop();
+
+private:
+    const int          _capacity;
+    QQueue<QByteArray> _chunks;
+    QMutex             _mutex;
+    QWaitCondition     _notEmpty;
+    QWaitCondition     _notFull;
+};
+
+class CompressThread;
+
+// Устройство только для записи: данные сжимаются и пишутся в открытый file.
+// Итог известен после close().
+class Writer : public QIODevice
+{
+public:
+    Writer(QFile* file, const Format format);
+    ~Writer() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+    bool isOk() const;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    QFile*          _file;
+    const Format    _format;
+    ChunkQueue      _queue;
+    CompressThread* _thread;
+    QByteArray      _pending;
+    bool            _ok;
+
+    Q_DISABLE_COPY(Writer)
+};
+}
+
+#endif // COMPRESSION_H
@@ -0,0 +1,38 @@
+# Ядро очистки без консоли и файлового ввода-вывода.
+# Используется программой (SubCleaner.pro) и библиотекой (SubCleanerLib.pro).
+# Разбор и вывод SSA/ASS (litescript) общие ещё и с SubCleanerLite.pro.
+
+QT += core concurrent
+QT -= gui
+
+SOURCES += \
+    $$PWD/litescript.cpp \
+    $$PWD/script.cpp \
+    $$PWD/tagfilter.cpp \
+    $$PWD/drawing.cpp \
+    $$PWD/eventfilter.cpp \
+    $$PWD/headerpolicy.cpp \
+    $$PWD/fontstore.cpp \
+    $$PWD/encoding.cpp \
+    $$PWD/snapshot.cpp \
+    $$PWD/timeindex.cpp \
+    $$PWD/timing.cpp \
+    $$PWD/engine.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/pass.cpp
+
+HEADERS += \
+    $$PWD/litescript.h \
+    $$PWD/script.h \
+    $$PWD/tagfilter.h \
+    $$PWD/drawing.h \
+    $$PWD/eventfilter.h \
+    $$PWD/headerpolicy.h \
+    $$PWD/fontstore.h \
+    $$PWD/encoding.h \
+    $$PWD/snapshot.h \
+    $$PWD/timeindex.h \
+    $$PWD/timing.h \
+    $$PWD/engine.h \
+    $$PWD/trace.h \
+    $$PWD/pass.h
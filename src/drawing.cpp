@@ -0,0 +1,258 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "drawing.h"
+#include <QVector>
+#include <QPair>
+#include <QPointF>
+#include <QStringList>
+#include <cmath>
+
+namespace Drawing
+{
+namespace
+{
+const QString drawCommands = "mnlbspc";
+
+struct Segment
+{
+    QChar            command;
+    QVector<QPointF> points;
+};
+
+// Расстояние от точки до отрезка
+double Distance(const QPointF& p, const QPointF& a, const QPointF& b)
+{
+    const double dx = b.x() - a.x(),
+                 dy = b.y() - a.y(),
+                 len2 = dx * dx + dy * dy;
+
+    double t = 0.0;
+    if (len2 > 0.0)
+    {
+        t = qBound(0.0, ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / len2, 1.0);
+    }
+
+    return std::hypot(p.x() - a.x() - t * dx, p.y() - a.y() - t * dy);
+}
+
+// Рамер-Дуглас-Пекер без рекурсии
+QVector<QPointF> Reduce(const QVector<QPointF>& points, const double tolerance)
+{
+    const int n = points.length();
+    if (n < 3) return points;
+
+    QVector<bool> keep(n, false);
+    keep[0] = keep[n - 1] = true;
+
+    QVector< QPair<int, int> > stack = {qMakePair(0, n - 1)};
+    while (!stack.isEmpty())
+    {
+        const QPair<int, int> range = stack.takeLast();
+        const QPointF& a = points.at(range.first);
+        const QPointF& b = points.at(range.second);
+
+        double maxDistance = -1.0;
+        int index = -1;
+        for (int i = range.first + 1; i < range.second; ++i)
+        {
+            const double d = Distance(points.at(i), a, b);
+            if (d > maxDistance)
+            {
+                maxDistance = d;
+                index = i;
+            }
+        }
+
+        if (index >= 0 && maxDistance > tolerance)
+        {
+            keep[index] = true;
+            stack.append(qMakePair(range.first, index));
+            stack.append(qMakePair(index, range.second));
+        }
+    }
+
+    QVector<QPointF> result;
+    for (int i = 0; i < n; ++i)
+    {
+        if (keep.at(i)) result.append(points.at(i));
+    }
+    return result;
+}
+
+bool Parse(const QString& commands, QVector<Segment>& segments)
+{
+    const QStringList tokens = commands.simplified().split(' ', QString::SkipEmptyParts);
+    QVector<double> numbers;
+    Segment current;
+
+    auto flush = [&]() {
+        if (current.command.isNull()) return numbers.isEmpty();
+        if (numbers.length() % 2) return false;
+
+        for (int i = 0; i < numbers.length(); i += 2)
+        {
+            current.points.append( QPointF(numbers.at(i), numbers.at(i + 1)) );
+        }
+        segments.append(current);
+        return true;
+    };
+
+    for (const QString& token : tokens)
+    {
+        if (1 == token.length() && token.at(0).isLetter())
+        {
+            if (!flush()) return false;
+
+            current.command = token.at(0).toLower();
+            current.points.clear();
+            numbers.clear();
+            if (!drawCommands.contains(current.command)) return false;
+        }
+        else
+        {
+            bool ok;
+            numbers.append( token.toDouble(&ok) );
+            if (!ok) return false;
+        }
+    }
+
+    return flush();
+}
+}
+
+QString SimplifyCommands(const QString& commands, const int scale, const double tolerance, bool* ok)
+{
+    QVector<Segment> segments;
+    if ( scale < 1 || !Parse(commands, segments) )
+    {
+        if (ok) *ok = false;
+        return commands;
+    }
+
+    // Один пиксель скрипта - 2^(scale-1) единиц рисования
+    const double grid = std::ldexp(1.0, qMin(scale, 16) - 1),
+                 limit = tolerance * grid;
+
+    auto snap = [grid](const QPointF& p) {
+        return QPointF(std::round(p.x() / grid) * grid, std::round(p.y() / grid) * grid);
+    };
+
+    QStringList result;
+    QPointF pen;
+    bool hasPen = false;
+    for (int i = 0, len = segments.length(); i < len; ++i)
+    {
+        QVector<QPointF> points;
+        const QChar command = segments.at(i).command;
+
+        if ('l' == command)
+        {
+            // Подряд идущие линии - одна ломаная, начинающаяся в текущей точке
+            QVector<QPointF> line;
+            if (hasPen) line.append(pen);
+            for (; i < len && 'l' == segments.at(i).command; ++i) line += segments.at(i).points;
+            --i;
+
+            for (const QPointF& p : Reduce(line, limit))
+            {
+                const QPointF s = snap(p);
+                if (!hasPen || s != pen)
+                {
+                    points.append(s);
+                    pen = s;
+                    hasPen = true;
+                }
+            }
+            if (points.isEmpty()) continue;
+        }
+        else
+        {
+            for (const QPointF& p : segments.at(i).points) points.append( snap(p) );
+            if (!points.isEmpty())
+            {
+                pen = points.last();
+                hasPen = true;
+            }
+        }
+
+        result.append( QString(command) );
+        for (const QPointF& p : qAsConst(points))
+        {
+            result.append( QString::number(static_cast<qint64>(p.x())) );
+            result.append( QString::number(static_cast<qint64>(p.y())) );
+        }
+    }
+
+    if (ok) *ok = true;
+    return result.join(' ');
+}
+
+bool SimplifyText(QString& text, const double tolerance)
+{
+    if (!text.contains("\\p")) return false;
+
+    QString result;
+    result.reserve(text.length());
+
+    int scale = 0, i = 0;
+    const int len = text.length();
+    bool changed = false;
+    while (i < len)
+    {
+        // Блок тегов: запоминаем последний \pN
+        if ('{' == text.at(i))
+        {
+            int end = text.indexOf('}', i);
+            if (end < 0) end = len - 1;
+
+            const QStringRef block = text.midRef(i, end - i + 1);
+            for (int pos = block.indexOf("\\p"); pos >= 0; pos = block.indexOf("\\p", pos + 2))
+            {
+                int digits = pos + 2;
+                while (digits < block.length() && block.at(digits).isDigit()) ++digits;
+                if (digits > pos + 2) scale = block.mid(pos + 2, digits - pos - 2).toInt();
+            }
+
+            result.append(block);
+            i = end + 1;
+            continue;
+        }
+
+        int next = text.indexOf('{', i);
+        if (next < 0) next = len;
+
+        const QString segment = text.mid(i, next - i);
+        bool ok = false;
+        const QString simplified = scale > 0 ? SimplifyCommands(segment, scale, tolerance, &ok) : QString();
+        if (ok && simplified != segment)
+        {
+            result.append(simplified);
+            changed = true;
+        }
+        else
+        {
+            result.append(segment);
+        }
+        i = next;
+    }
+
+    if (changed) text = result;
+    return changed;
+}
+}
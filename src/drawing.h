@@ -0,0 +1,35 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DRAWING_H
+#define DRAWING_H
+
+#include <QString>
+
+namespace Drawing
+{
+// Упрощает все рисунки (\p1 и выше) в тексте события.
+// tolerance - допустимое отклонение в пикселях скрипта (PlayResX/PlayResY),
+// координаты округляются до пикселя скрипта.
+bool SimplifyText(QString& text, const double tolerance);
+
+// Упрощает одну строку команд рисования в масштабе \p<scale>
+QString SimplifyCommands(const QString& commands, const int scale, const double tolerance, bool* ok = nullptr);
+}
+
+#endif // DRAWING_H
@@ -0,0 +1,214 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "encoding.h"
+#include <QTextCodec>
+#include <cstring>
+
+namespace Encoding
+{
+namespace
+{
+// Кандидаты для файлов без BOM и не в UTF-8
+const char* const legacyCodecs[] = {"windows-1251", "KOI8-R", "Shift_JIS", "GBK", "Big5", "EUC-KR", "windows-1252"};
+
+// Для оценки достаточно начала файла
+const int sampleSize = 64 * 1024;
+
+// Чем больше похоже на текст, тем выше оценка
+int Score(QTextCodec* codec, const QByteArray& sample)
+{
+    QTextCodec::ConverterState state;
+    const QString text = codec->toUnicode(sample.constData(), sample.size(), &state);
+
+    int score = -20 * state.invalidChars;
+    QChar::Category previous = QChar::Other_NotAssigned;
+    for (const QChar c : text)
+    {
+        if (c.unicode() < 0x80)
+        {
+            previous = QChar::Other_NotAssigned;
+            continue;
+        }
+
+        const QChar::Category category = c.category();
+        switch (category)
+        {
+        case QChar::Letter_Lowercase:
+            score += 2;
+            break;
+
+        case QChar::Letter_Uppercase:
+            // ЗаГлАвНыЕ посреди слова - признак чужой кодовой страницы
+            score += QChar::Letter_Lowercase == previous ? -2 : 1;
+            break;
+
+        case QChar::Letter_Other:
+            score += 3;
+            break;
+
+        case QChar::Other_Control:
+        case QChar::Other_NotAssigned:
+        case QChar::Other_PrivateUse:
+        case QChar::Other_Surrogate:
+            score -= 10;
+            break;
+
+        default:
+            score -= 1;
+            break;
+        }
+        previous = category;
+    }
+
+    return score;
+}
+
+bool IsUtf8Detection(const Detection& detection)
+{
+    return ENC_HEURISTIC != detection.method && "UTF-8" == detection.codec->name();
+}
+
+QString DecodeAs(const QByteArray& data, const Detection& detection)
+{
+    const char* const begin = data.constData() + detection.bomLength;
+    const int len = data.size() - detection.bomLength;
+    if ( IsUtf8Detection(detection) )
+    {
+        return QString::fromUtf8(begin, len);
+    }
+    return detection.codec->toUnicode(begin, len);
+}
+}
+
+// Проверка UTF-8. ASCII пропускается по 8 байт за раз.
+bool IsUtf8(const char* data, const int len)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(data);
+    const uchar* const end = p + len;
+
+    while (p < end)
+    {
+        if (end - p >= 8)
+        {
+            quint64 chunk;
+            std::memcpy(&chunk, p, sizeof(chunk));
+            if ( !(chunk & Q_UINT64_C(0x8080808080808080)) )
+            {
+                p += 8;
+                continue;
+            }
+        }
+
+        const uchar c = *p;
+        if (c < 0x80)
+        {
+            ++p;
+            continue;
+        }
+
+        int n;
+        uint min, cp;
+        if      (0xC0 == (c & 0xE0)) { n = 1; min = 0x80;    cp = c & 0x1F; }
+        else if (0xE0 == (c & 0xF0)) { n = 2; min = 0x800;   cp = c & 0x0F; }
+        else if (0xF0 == (c & 0xF8)) { n = 3; min = 0x10000; cp = c & 0x07; }
+        else return false;
+
+        if (end - p <= n) return false;
+        for (int i = 1; i <= n; ++i)
+        {
+            if (0x80 != (p[i] & 0xC0)) return false;
+            cp = cp << 6 | (p[i] & 0x3F);
+        }
+
+        // Слишком длинные последовательности и суррогаты
+        if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return false;
+        p += n + 1;
+    }
+
+    return true;
+}
+
+Detection Detect(const QByteArray& data)
+{
+    if ( data.startsWith("\xEF\xBB\xBF") ) return {QTextCodec::codecForName("UTF-8"),    ENC_BOM, 3};
+    if ( data.startsWith("\xFF\xFE") )     return {QTextCodec::codecForName("UTF-16LE"), ENC_BOM, 2};
+    if ( data.startsWith("\xFE\xFF") )     return {QTextCodec::codecForName("UTF-16BE"), ENC_BOM, 2};
+
+    if ( IsUtf8(data.constData(), data.size()) ) return {QTextCodec::codecForName("UTF-8"), ENC_UTF8, 0};
+
+    const QByteArray sample = QByteArray::fromRawData(data.constData(), qMin(data.size(), sampleSize));
+    QTextCodec* best = nullptr;
+    int bestScore = 0;
+    for (const char* const name : legacyCodecs)
+    {
+        QTextCodec* const codec = QTextCodec::codecForName(name);
+        if (!codec) continue;
+
+        const int score = Score(codec, sample);
+        if (!best || score > bestScore)
+        {
+            best = codec;
+            bestScore = score;
+        }
+    }
+
+    return {best ? best : QTextCodec::codecForLocale(), ENC_HEURISTIC, 0};
+}
+
+QString Decode(const QByteArray& data, Detection* detection)
+{
+    const Detection result = Detect(data);
+    if (detection) *detection = result;
+    return DecodeAs(data, result);
+}
+
+// Без BOM проверка уже сделана в Detect(). После BOM текст может быть битым
+// или начинаться со второго BOM - тогда как раньше, через QString.
+QByteArray ToUtf8(const QByteArray& data, Detection* detection)
+{
+    const Detection result = Detect(data);
+    if (detection) *detection = result;
+
+    if ( IsUtf8Detection(result) )
+    {
+        if (0 == result.bomLength) return data;
+
+        const char* const begin = data.constData() + result.bomLength;
+        const int len = data.size() - result.bomLength;
+        if ( !QByteArray::fromRawData(begin, len).startsWith("\xEF\xBB\xBF") && IsUtf8(begin, len) ) return QByteArray(begin, len);
+    }
+    return DecodeAs(data, result).toUtf8();
+}
+
+QString Describe(const Detection& detection)
+{
+    const QString name = QString::fromLatin1(detection.codec->name());
+    switch (detection.method)
+    {
+    case ENC_BOM:
+        return QString("%1 (BOM)").arg(name);
+
+    case ENC_UTF8:
+        return QString("%1 (valid)").arg(name);
+
+    default:
+        return QString("%1 (guessed)").arg(name);
+    }
+}
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <QByteArray>
+#include <QString>
+
+class QTextCodec;
+
+// Определение кодировки входного файла:
+// BOM, затем проверка UTF-8, затем оценка старых кодовых страниц
+namespace Encoding
+{
+enum Method {ENC_BOM, ENC_UTF8, ENC_HEURISTIC};
+
+struct Detection
+{
+    QTextCodec* codec;
+    Method      method;
+    int         bomLength;
+};
+
+bool IsUtf8(const char* data, const int len);
+Detection Detect(const QByteArray& data);
+QString Decode(const QByteArray& data, Detection* detection = nullptr);
+// Текст в UTF-8 без BOM; файл в UTF-8 возвращается без перекодирования
+QByteArray ToUtf8(const QByteArray& data, Detection* detection = nullptr);
+QString Describe(const Detection& detection);
+}
+
+#endif // ENCODING_H
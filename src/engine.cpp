@@ -0,0 +1,522 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "engine.h"
+#include "drawing.h"
+#include "fontstore.h"
+#include "encoding.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "pass.h"
+#include <algorithm>
+
+namespace
+{
+const int flushSize = 256 * 1024;
+
+template <Script::ScriptType T>
+void AppendEvents(QByteArrayList& result, const QList<Script::Line::Event*>& events)
+{
+    for (const Script::Line::Event* const e : events)
+    {
+        QByteArray line = e->generateUtf8<T>();
+        line.append('\n');
+        result.append(line);
+    }
+}
+
+template <Script::ScriptType T>
+void AppendEvents(QByteArray& result, const QList<Script::Line::Event*>& events)
+{
+    for (const Script::Line::Event* const e : events)
+    {
+        result.append( e->generateUtf8<T>() );
+        result.append('\n');
+    }
+}
+
+template <Script::ScriptType T>
+bool WriteEvents(QIODevice& device, QByteArray& buffer, const QList<Script::Line::Event*>& events)
+{
+    for (const Script::Line::Event* const e : events)
+    {
+        buffer.append( e->generateUtf8<T>() );
+        buffer.append('\n');
+        if (buffer.size() >= flushSize)
+        {
+            if (device.write(buffer) != buffer.size()) return false;
+            buffer.clear();
+        }
+    }
+    return true;
+}
+
+//
+// Проходы очистки
+//
+class EventFilterPass : public Pass
+{
+public:
+    explicit EventFilterPass(const EventFilter& filter) :
+        Pass("filter events", EventLines),
+        _filter(filter)
+    {}
+
+    void begin(Script::Script& script) override
+    {
+        _prepared = _filter.prepare(script);
+    }
+
+    bool event(Script::Line::Event* line) override
+    {
+        return !_filter.accepts(_prepared, line);
+    }
+
+private:
+    const EventFilter& _filter;
+    EventFilter::Prepared _prepared;
+};
+
+class StripCommentsPass : public Pass
+{
+public:
+    StripCommentsPass() :
+        Pass("strip comments", HeaderLines | StyleLines | EventLines)
+    {}
+
+    bool header(Script::Line::Named* line) override
+    {
+        line->clearBefore();
+        return false;
+    }
+
+    bool style(Script::Line::Style* line) override
+    {
+        line->clearBefore();
+        return false;
+    }
+
+    bool event(Script::Line::Event* line) override
+    {
+        line->clearBefore();
+        return false;
+    }
+
+    void end(Script::Script& script) override
+    {
+        script.header.clearAfter();
+        script.styles.clearAfter();
+        script.events.clearAfter();
+        script.clearBefore();
+        script.clearAfter();
+    }
+};
+
+class StripInfoPass : public Pass
+{
+public:
+    explicit StripInfoPass(const HeaderPolicy& policy) :
+        Pass("strip info", HeaderLines),
+        _policy(policy)
+    {}
+
+    bool header(Script::Line::Named* line) override
+    {
+        return !_policy.keepKey(line->name());
+    }
+
+private:
+    const HeaderPolicy& _policy;
+};
+
+class StripSectionsPass : public Pass
+{
+public:
+    explicit StripSectionsPass(const HeaderPolicy& policy) :
+        Pass("strip sections", ExtraSections),
+        _policy(policy)
+    {}
+
+    bool extra(const Script::Section<Script::Line::Base>* section) override
+    {
+        return !_policy.keepSection(section->name());
+    }
+
+private:
+    const HeaderPolicy& _policy;
+};
+
+// Только по завершении: шрифты к этому времени уже собраны
+class StripAttachmentsPass : public Pass
+{
+public:
+    StripAttachmentsPass() :
+        Pass("strip attachments", Targets())
+    {}
+
+    void end(Script::Script& script) override
+    {
+        script.fonts.clear();
+        script.graphics.clear();
+    }
+};
+
+class StripTagsPass : public Pass
+{
+public:
+    explicit StripTagsPass(const TagFilter& filter) :
+        Pass("strip tags", EventText),
+        _filter(filter)
+    {}
+
+    bool text(QString& text) override
+    {
+        return _filter.apply(text);
+    }
+
+private:
+    const TagFilter& _filter;
+};
+
+class SimplifyDrawingsPass : public Pass
+{
+public:
+    explicit SimplifyDrawingsPass(const double tolerance) :
+        Pass("simplify drawings", EventText),
+        _tolerance(tolerance)
+    {}
+
+    bool text(QString& text) override
+    {
+        return Drawing::SimplifyText(text, _tolerance);
+    }
+
+private:
+    const double _tolerance;
+};
+}
+
+Engine::Engine(const Options flags) :
+    _flags(flags),
+    _drawingTolerance(-1.0),
+    _hasRange(false),
+    _rangeStart(0),
+    _rangeEnd(0),
+    _rebase(false)
+{}
+
+Engine::Options Engine::flags() const
+{
+    return _flags;
+}
+
+void Engine::setStripTags(const QStringList &tags)
+{
+    _tagFilter = TagFilter(tags);
+}
+
+void Engine::setDrawingTolerance(const double tolerance)
+{
+    _drawingTolerance = tolerance;
+}
+
+void Engine::setEventFilter(const EventFilter &filter)
+{
+    _eventFilter = filter;
+}
+
+void Engine::setHeaderPolicy(const HeaderPolicy &policy)
+{
+    _headerPolicy = policy;
+}
+
+void Engine::setFontDir(const QString &dir)
+{
+    _fontDir = dir;
+}
+
+void Engine::setRange(const uint start, const uint end, const bool rebase)
+{
+    _hasRange = true;
+    _rangeStart = start;
+    _rangeEnd = end;
+    _rebase = rebase;
+}
+
+void Engine::setRetime(const Timing::Retime &retime)
+{
+    _retime = retime;
+}
+
+void Engine::setFrameGrid(const Timing::FrameGrid &grid)
+{
+    _frameGrid = grid;
+}
+
+bool Engine::parse(const QByteArray &data, Script::Script &script, Script::ScriptType &scriptType, Stats *stats, QString *error) const
+{
+    // Pre-parsed snapshot
+    if ( Snapshot::IsSnapshot(data) )
+    {
+        if ( !Snapshot::Load(data, script, scriptType) )
+        {
+            if (error) *error = "Broken snapshot.";
+            return false;
+        }
+        return true;
+    }
+
+    // UTF-8 разбирается как есть, остальное перекодируется в UTF-8 один раз
+    Encoding::Detection encoding;
+    QByteArray text;
+    {
+        Trace::Span span("decode");
+        text = Encoding::ToUtf8(data, &encoding);
+    }
+    if (stats) stats->append(qMakePair(QString("Encoding"), Encoding::Describe(encoding)));
+
+    {
+        Trace::Span span("detect");
+        scriptType = Script::DetectFormat(text);
+    }
+
+    Trace::Span span("parse");
+    switch (scriptType)
+    {
+    case Script::SCR_SSA:
+    case Script::SCR_ASS:
+        if ( !Script::ParseSSA(text, script) )
+        {
+            if (error) *error = "Not an SSA/ASS file.";
+            return false;
+        }
+        break;
+
+    case Script::SCR_SRT:
+        if ( !Script::ParseSRT(text, script) )
+        {
+            if (error) *error = "Not a valid SRT file.";
+            return false;
+        }
+        break;
+
+    default:
+        if (error) *error = "File format is unknown.";
+        return false;
+    }
+
+    return true;
+}
+
+bool Engine::clean(Script::Script &script, const Script::ScriptType scriptType, Stats *stats, QString *error) const
+{
+    // Parse deferred events up front: passes and concurrent generation
+    // read them, and parsing on first access writes to script.names
+    {
+        Trace::Span span("parse events");
+        script.parseEvents();
+    }
+
+    // Extract fonts in background
+    QFuture<QString> fonts;
+    if (!_fontDir.isEmpty())
+    {
+        Trace::Span span("collect fonts");
+        fonts = FontStore::Extract(FontStore::Collect(script.fonts), _fontDir);
+    }
+
+    // Filter events first: range, timing and sorting see fewer of them
+    if (!_eventFilter.isEmpty())
+    {
+        Trace::Span span("filter events");
+        PassList passes;
+        passes.add(new EventFilterPass(_eventFilter));
+        const QVector<int> dropped = passes.run(script);
+        if (stats) stats->append(qMakePair(QString("Dropped events"), QString::number(dropped.first())));
+    }
+
+    // Cut time range
+    if (_hasRange)
+    {
+        Trace::Span span("cut range");
+        QList<Script::Line::Event*>& events = script.events.content;
+        const QVector<int> inRange = TimeIndex(events).query(_rangeStart, _rangeEnd);
+
+        QList<Script::Line::Event*> kept;
+        kept.reserve(inRange.length());
+        for (const int i : inRange)
+        {
+            kept.append(events.at(i));
+            events[i] = nullptr;
+        }
+        qDeleteAll(events);
+        events = kept;
+
+        if (_rebase)
+        {
+            for (Script::Line::Event* const line : qAsConst(events)) {
+                line->setStart( std::max(line->start(), _rangeStart) - _rangeStart );
+                line->setEnd( std::min(line->end(), _rangeEnd) - _rangeStart );
+            }
+        }
+
+        if (stats) stats->append(qMakePair(QString("Events in range"), QString::number(events.length())));
+    }
+
+    // Shift, rescale and snap times
+    const uint timeUnit = Script::SCR_SSA == scriptType || Script::SCR_ASS == scriptType ? 10u : 1u;
+    if (!_retime.isIdentity())
+    {
+        Trace::Span span("retime");
+        Timing::Apply(script.events.content, _retime, timeUnit);
+    }
+    if (!_frameGrid.isEmpty())
+    {
+        Trace::Span span("snap");
+        const int snapped = _frameGrid.snap(script.events.content, timeUnit);
+        if (stats) stats->append(qMakePair(QString("Snapped times"), QString::number(snapped)));
+    }
+
+    // Sort by time
+    if (_flags.testFlag(SortEvents))
+    {
+        Trace::Span span("sort");
+        Timing::Sort(script.events.content);
+
+        const Timing::Diagnostics diagnostics = Timing::Diagnose(script.events.content, script.names.styles.count());
+        if (stats)
+        {
+            stats->append(qMakePair(QString("Negative durations"), QString::number(diagnostics.negativeDurations)));
+            stats->append(qMakePair(QString("Same-style overlaps"), QString::number(diagnostics.styleOverlaps)));
+        }
+    }
+
+    // Strip and rewrite lines in one traversal per section
+    {
+        Trace::Span span("strip");
+        PassList passes;
+        if (_flags.testFlag(StripComments)) passes.add(new StripCommentsPass());
+        if (_flags.testFlag(StripStyleInfo)) passes.add(new StripInfoPass(_headerPolicy));
+        passes.add(new StripSectionsPass(_headerPolicy));
+        passes.add(new StripAttachmentsPass());
+        if (!_tagFilter.isEmpty()) passes.add(new StripTagsPass(_tagFilter));
+        if (_drawingTolerance >= 0.0) passes.add(new SimplifyDrawingsPass(_drawingTolerance));
+
+        const QVector<int> removed = passes.run(script);
+        for (int i = 0; i < passes.length(); ++i)
+        {
+            if (stats && removed.at(i)) stats->append(qMakePair(QString("Removed by %1").arg(passes.at(i)->name()), QString::number(removed.at(i))));
+        }
+    }
+
+    {
+        Trace::Span span("wait fonts");
+        fonts.waitForFinished();
+    }
+    if (fonts.results().contains(QString()))
+    {
+        if (error) *error = QString("Can't extract fonts to \"%1\".").arg(_fontDir);
+        return false;
+    }
+
+    return true;
+}
+
+bool Engine::generate(const Script::Script &script, const Script::ScriptType scriptType, QByteArray &data, QString *error) const
+{
+    Trace::Span span("generate");
+    data.clear();
+    switch (scriptType)
+    {
+    // Строки модели уже в UTF-8: собираем байты без QTextStream
+    case Script::SCR_SSA:
+    case Script::SCR_ASS:
+        data = "\xEF\xBB\xBF";
+        data.append( script.generateHead(scriptType) );
+        if (Script::SCR_ASS == scriptType) AppendEvents<Script::SCR_ASS>(data, script.events.content);
+        else                               AppendEvents<Script::SCR_SSA>(data, script.events.content);
+        data.append( script.generateTail(scriptType) );
+        break;
+
+    case Script::SCR_SRT:
+        data = "\xEF\xBB\xBF" + script.generate(scriptType).toUtf8();
+        break;
+
+    default:
+        if (error) *error = "Houston, we have a problem.";
+        return false;
+    }
+
+    return true;
+}
+
+bool Engine::generate(const Script::Script &script, const Script::ScriptType scriptType, QIODevice &device, QString *error) const
+{
+    QByteArray data;
+    bool ok;
+    if (Script::SCR_SSA != scriptType && Script::SCR_ASS != scriptType)
+    {
+        if ( !this->generate(script, scriptType, data, error) ) return false;
+        ok = true;
+    }
+    else
+    {
+        Trace::Span span("generate");
+        data = "\xEF\xBB\xBF";
+        data.append( script.generateHead(scriptType) );
+        ok = Script::SCR_ASS == scriptType ? WriteEvents<Script::SCR_ASS>(device, data, script.events.content)
+                                           : WriteEvents<Script::SCR_SSA>(device, data, script.events.content);
+        data.append( script.generateTail(scriptType) );
+    }
+
+    if ( !ok || device.write(data) != data.size() )
+    {
+        if (error) *error = "Can't write output.";
+        return false;
+    }
+    return true;
+}
+
+bool Engine::generateParts(const Script::Script &script, const Script::ScriptType scriptType, QByteArray &head, QByteArrayList &events, QByteArray &tail, QString *error) const
+{
+    if (Script::SCR_SSA != scriptType && Script::SCR_ASS != scriptType)
+    {
+        if (error) *error = "Houston, we have a problem.";
+        return false;
+    }
+
+    Trace::Span span("generate");
+    head = "\xEF\xBB\xBF" + script.generateHead(scriptType);
+
+    events.clear();
+    events.reserve(script.events.content.length());
+    if (Script::SCR_ASS == scriptType) AppendEvents<Script::SCR_ASS>(events, script.events.content);
+    else                               AppendEvents<Script::SCR_SSA>(events, script.events.content);
+
+    tail = script.generateTail(scriptType);
+    return true;
+}
+
+bool Engine::process(const QByteArray &input, QByteArray &output, Stats *stats, QString *error) const
+{
+    Script::Script script;
+    Script::ScriptType scriptType;
+    return this->parse(input, script, scriptType, stats, error) &&
+           this->clean(script, scriptType, stats, error) &&
+           this->generate(script, scriptType, output, error);
+}
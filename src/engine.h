@@ -0,0 +1,92 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "script.h"
+#include "tagfilter.h"
+#include "eventfilter.h"
+#include "headerpolicy.h"
+#include "timeindex.h"
+#include "timing.h"
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QIODevice>
+#include <QPair>
+
+// Очистка скрипта в памяти, без файлов и цикла событий.
+// Константные методы не меняют общих данных (маски фильтра компилируются
+// на каждый вызов), поэтому настроенный Engine можно использовать из нескольких
+// потоков. Методы set*() одновременно с обработкой вызывать нельзя.
+class Engine
+{
+public:
+    enum Option {
+        StripComments  = 1 << 0,
+        StripStyleInfo = 1 << 1,
+        ShowStats      = 1 << 2,
+        SortEvents     = 1 << 3
+    };
+    Q_DECLARE_FLAGS(Options, Option)
+
+    typedef QList< QPair<QString, QString> > Stats;
+
+    explicit Engine(const Options flags = Options());
+
+    Options flags() const;
+    void setStripTags(const QStringList &tags);
+    void setDrawingTolerance(const double tolerance);
+    void setEventFilter(const EventFilter &filter);
+    void setHeaderPolicy(const HeaderPolicy &policy);
+    void setFontDir(const QString &dir);
+    // Оставить только события, пересекающие [start, end); rebase - сдвинуть окно к нулю
+    void setRange(const uint start, const uint end, const bool rebase);
+    void setRetime(const Timing::Retime &retime);
+    void setFrameGrid(const Timing::FrameGrid &grid);
+
+    bool parse(const QByteArray &data, Script::Script &script, Script::ScriptType &scriptType, Stats *stats = nullptr, QString *error = nullptr) const;
+    // scriptType - формат вывода: от него зависит округление времени
+    bool clean(Script::Script &script, const Script::ScriptType scriptType, Stats *stats = nullptr, QString *error = nullptr) const;
+    bool generate(const Script::Script &script, const Script::ScriptType scriptType, QByteArray &data, QString *error = nullptr) const;
+    // То же, но SSA/ASS пишется в device кусками по мере генерации
+    bool generate(const Script::Script &script, const Script::ScriptType scriptType, QIODevice &device, QString *error = nullptr) const;
+    // SSA/ASS по частям: до событий (с BOM), каждое событие и после событий.
+    // Склеенные части совпадают с выводом generate().
+    bool generateParts(const Script::Script &script, const Script::ScriptType scriptType, QByteArray &head, QByteArrayList &events, QByteArray &tail, QString *error = nullptr) const;
+
+    // Всё сразу: текст (или снимок) на входе, UTF-8 с BOM на выходе
+    bool process(const QByteArray &input, QByteArray &output, Stats *stats = nullptr, QString *error = nullptr) const;
+
+private:
+    Options _flags;
+    TagFilter _tagFilter;
+    double _drawingTolerance;
+    EventFilter _eventFilter;
+    HeaderPolicy _headerPolicy;
+    QString _fontDir;
+    bool _hasRange;
+    uint _rangeStart;
+    uint _rangeEnd;
+    bool _rebase;
+    Timing::Retime _retime;
+    Timing::FrameGrid _frameGrid;
+};
+Q_DECLARE_OPERATORS_FOR_FLAGS(Engine::Options)
+
+#endif // ENGINE_H
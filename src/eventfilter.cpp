@@ -0,0 +1,158 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "eventfilter.h"
+#include <QRegExp>
+#include <algorithm>
+
+namespace
+{
+// Свои QRegExp на каждый вызов
+QList<QRegExp> Compile(const QStringList& patterns)
+{
+    QList<QRegExp> result;
+    for (const QString& pattern : patterns)
+    {
+        result.append( QRegExp(pattern, Qt::CaseInsensitive, QRegExp::Wildcard) );
+    }
+    return result;
+}
+}
+
+EventFilter::EventFilter() :
+    _layerMask(0)
+{}
+
+QStringList EventFilter::trimmed(const QStringList& patterns)
+{
+    QStringList result;
+    for (const QString& pattern : patterns) result.append( pattern.trimmed() );
+    return result;
+}
+
+void EventFilter::addDropStyles(const QStringList& patterns)
+{
+    _style.drop.append( trimmed(patterns) );
+}
+
+void EventFilter::addKeepStyles(const QStringList& patterns)
+{
+    _style.keep.append( trimmed(patterns) );
+}
+
+void EventFilter::addDropActors(const QStringList& patterns)
+{
+    _actor.drop.append( trimmed(patterns) );
+}
+
+void EventFilter::addDropEffects(const QStringList& patterns)
+{
+    _effect.drop.append( trimmed(patterns) );
+}
+
+// Слои: "3", "0-2" или список через запятую
+bool EventFilter::addDropLayers(const QString& spec)
+{
+    for (const QString& item : spec.split(',', QString::SkipEmptyParts))
+    {
+        const QStringList bounds = item.split('-');
+        bool okFirst = false, okLast = false;
+        const uint first = bounds.first().trimmed().toUInt(&okFirst);
+        const uint last  = bounds.length() > 1 ? bounds.at(1).trimmed().toUInt(&okLast) : first;
+        if (!okFirst || (bounds.length() > 1 && !okLast) || bounds.length() > 2 || last < first) return false;
+
+        // Маленькие слои - в битовую маску, остаток диапазона - в список
+        for (uint layer = first; layer <= last && layer < 64; ++layer) _layerMask |= Q_UINT64_C(1) << layer;
+        if (last >= 64) _layerRanges.append( qMakePair(qMax(first, 64u), last) );
+    }
+    return true;
+}
+
+bool EventFilter::Field::isEmpty() const
+{
+    return drop.isEmpty() && keep.isEmpty();
+}
+
+// Вердикт для каждой используемой строки таблицы
+QBitArray EventFilter::Field::compile(const Script::StringPool& pool) const
+{
+    QBitArray dropped(pool.count());
+    if (this->isEmpty()) return dropped;
+
+    const QList<QRegExp> dropRe = Compile(drop), keepRe = Compile(keep);
+
+    for (Script::StringPool::Id id = 0, len = pool.count(); id < len; ++id)
+    {
+        if (!pool.usage(id)) continue;
+
+        const QString& name = pool.at(id);
+        auto matches = [&name](const QRegExp& re) { return re.exactMatch(name); };
+
+        bool drop = !keepRe.isEmpty() && std::none_of(keepRe.cbegin(), keepRe.cend(), matches);
+        if (!drop) drop = std::any_of(dropRe.cbegin(), dropRe.cend(), matches);
+        dropped.setBit(id, drop);
+    }
+    return dropped;
+}
+
+bool EventFilter::isEmpty() const
+{
+    return _style.isEmpty() && _actor.isEmpty() && _effect.isEmpty() && !_layerMask && _layerRanges.isEmpty();
+}
+
+bool EventFilter::dropLayer(const uint layer) const
+{
+    if (layer < 64) return _layerMask & (Q_UINT64_C(1) << layer);
+
+    for (const QPair<uint, uint>& range : _layerRanges)
+    {
+        if (layer >= range.first && layer <= range.second) return true;
+    }
+    return false;
+}
+
+EventFilter::Prepared EventFilter::prepare(const Script::Script& script) const
+{
+    return {_style.compile(script.names.styles), _actor.compile(script.names.actors), _effect.compile(script.names.effects)};
+}
+
+bool EventFilter::accepts(const Prepared& prepared, const Script::Line::Event* const e) const
+{
+    return !dropLayer( e->layer() ) &&
+           !prepared.styles.testBit(e->styleId()) &&
+           !prepared.actors.testBit(e->actorId()) &&
+           !prepared.effects.testBit(e->effectId());
+}
+
+int EventFilter::apply(Script::Script& script) const
+{
+    if (this->isEmpty()) return 0;
+
+    const Prepared prepared = this->prepare(script);
+    auto accepts = [&](const Script::Line::Event* const e) {
+        return this->accepts(prepared, e);
+    };
+
+    QList<Script::Line::Event*>& content = script.events.content;
+    const auto it = std::stable_partition(content.begin(), content.end(), accepts);
+    const int removed = static_cast<int>(content.end() - it);
+    qDeleteAll(it, content.end());
+    content.erase(it, content.end());
+
+    return removed;
+}
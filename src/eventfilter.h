@@ -0,0 +1,76 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENTFILTER_H
+#define EVENTFILTER_H
+
+#include "script.h"
+#include <QBitArray>
+#include <QPair>
+#include <QStringList>
+
+// Фильтр событий по стилю, актёру, слою и эффекту.
+// Маски сравниваются один раз для каждой строки таблиц Script::names,
+// дальше каждое событие проверяется по биту с номером строки.
+class EventFilter
+{
+public:
+    EventFilter();
+
+    void addDropStyles(const QStringList& patterns);
+    void addKeepStyles(const QStringList& patterns);
+    void addDropActors(const QStringList& patterns);
+    void addDropEffects(const QStringList& patterns);
+    bool addDropLayers(const QString& spec);
+
+    // Маски строк одного скрипта
+    struct Prepared
+    {
+        QBitArray styles;
+        QBitArray actors;
+        QBitArray effects;
+    };
+
+    bool isEmpty() const;
+    Prepared prepare(const Script::Script& script) const;
+    bool accepts(const Prepared& prepared, const Script::Line::Event* const e) const;
+    int apply(Script::Script& script) const;
+
+private:
+    // Правила для одного поля. Хранятся маски, а не QRegExp: exactMatch()
+    // пишет состояние в объект, а один фильтр работает из нескольких потоков.
+    struct Field
+    {
+        QStringList drop;
+        QStringList keep;
+
+        bool isEmpty() const;
+        QBitArray compile(const Script::StringPool& pool) const;
+    };
+
+    Field _style;
+    Field _actor;
+    Field _effect;
+    quint64 _layerMask;
+    QList< QPair<uint, uint> > _layerRanges;
+
+    static QStringList trimmed(const QStringList& patterns);
+    bool dropLayer(const uint layer) const;
+};
+
+#endif // EVENTFILTER_H
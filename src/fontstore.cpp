@@ -0,0 +1,119 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "fontstore.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+
+namespace FontStore
+{
+namespace
+{
+// Сохранение одного шрифта, выполняется в пуле потоков
+struct StoreFunctor
+{
+    typedef QString result_type;
+
+    QString dir;
+
+    QString operator()(const Attachment& attachment) const
+    {
+        const QByteArray data = Decode(attachment.encoded);
+        if (data.isEmpty()) return QString();
+
+        const QString suffix = QFileInfo(attachment.name).suffix().toLower();
+        QString fileName = QString::fromLatin1( QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex() );
+        if (!suffix.isEmpty()) fileName += '.' + suffix;
+
+        const QString path = QDir(dir).filePath(fileName);
+        if ( QFileInfo::exists(path) ) return path;
+
+        // QSaveFile: параллельный запуск не увидит недописанный файл
+        QSaveFile file(path);
+        if ( !file.open(QFile::WriteOnly) || file.write(data) != data.size() || !file.commit() ) return QString();
+
+        return path;
+    }
+};
+}
+
+QList<Attachment> Collect(const Script::Section<Script::Line::Base>& fonts)
+{
+    const QString ltFontName = "fontname:";
+
+    QList<Attachment> result;
+    for (const Script::Line::Base* const line : fonts.content)
+    {
+        const QString value = line->value();
+        if ( value.startsWith(ltFontName, Qt::CaseInsensitive) )
+        {
+            result.append({value.mid(ltFontName.length()).trimmed(), QByteArray()});
+        }
+        else if (!result.isEmpty())
+        {
+            result.last().encoded.append( value.toLatin1() );
+        }
+    }
+    return result;
+}
+
+// Кодировка SSA: 3 байта -> 4 символа по 6 бит + 33,
+// хвост из 2 или 3 символов даёт 1 или 2 байта
+QByteArray Decode(const QByteArray& encoded)
+{
+    const int len = encoded.length(),
+              full = len / 4,
+              tail = len % 4;
+    if (1 == tail) return QByteArray();
+
+    QByteArray result(full * 3 + (tail ? tail - 1 : 0), Qt::Uninitialized);
+    const uchar* src = reinterpret_cast<const uchar*>(encoded.constData());
+    uchar* dst = reinterpret_cast<uchar*>(result.data());
+
+    // Без ветвлений внутри цикла: компилятор может его векторизовать
+    for (int i = 0; i < full; ++i, src += 4, dst += 3)
+    {
+        const uint v = ((src[0] - 33u) & 63u) << 18 |
+                       ((src[1] - 33u) & 63u) << 12 |
+                       ((src[2] - 33u) & 63u) << 6  |
+                       ((src[3] - 33u) & 63u);
+        dst[0] = static_cast<uchar>(v >> 16);
+        dst[1] = static_cast<uchar>(v >> 8);
+        dst[2] = static_cast<uchar>(v);
+    }
+
+    if (tail)
+    {
+        uint v = 0;
+        for (int i = 0; i < tail; ++i) v |= ((src[i] - 33u) & 63u) << (18 - 6 * i);
+        dst[0] = static_cast<uchar>(v >> 16);
+        if (3 == tail) dst[1] = static_cast<uchar>(v >> 8);
+    }
+
+    return result;
+}
+
+QFuture<QString> Extract(const QList<Attachment>& attachments, const QString& dir)
+{
+    QDir().mkpath(dir);
+    return QtConcurrent::mapped(attachments, StoreFunctor{dir});
+}
+}
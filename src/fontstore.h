@@ -0,0 +1,45 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FONTSTORE_H
+#define FONTSTORE_H
+
+#include "script.h"
+#include <QByteArray>
+#include <QFuture>
+
+// Извлечение вложенных шрифтов в общее хранилище.
+// Файлы называются по SHA-256 содержимого, поэтому одинаковые шрифты
+// из разных серий хранятся один раз.
+namespace FontStore
+{
+struct Attachment
+{
+    QString    name;
+    QByteArray encoded;
+};
+
+QList<Attachment> Collect(const Script::Section<Script::Line::Base>& fonts);
+QByteArray Decode(const QByteArray& encoded);
+
+// Декодирует и сохраняет шрифты в пуле потоков.
+// Результат - пути сохранённых файлов, пустая строка при ошибке.
+QFuture<QString> Extract(const QList<Attachment>& attachments, const QString& dir);
+}
+
+#endif // FONTSTORE_H
@@ -0,0 +1,194 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "headerpolicy.h"
+#include <QFile>
+#include <QTextStream>
+#include <QTextCodec>
+
+HeaderPolicy::HeaderPolicy() :
+    _keepKeys(false),
+    _keepSections(false)
+{
+    // ScriptType добавляется всегда
+    const QStringList importantLines = {"WrapStyle", "PlayResX", "PlayResY", "ScaledBorderAndShadow", "YCbCr Matrix"};
+    _keys.compile(importantLines, QVector<Action>(importantLines.length(), Keep));
+}
+
+bool HeaderPolicy::load(const QString& fileName, QString* error)
+{
+    QFile file(fileName);
+    if ( !file.open(QFile::ReadOnly | QFile::Text) )
+    {
+        if (error) *error = QString("Can't read file \"%1\".").arg(fileName);
+        return false;
+    }
+
+    QTextStream in(&file);
+    in.setCodec( QTextCodec::codecForName("UTF-8") );
+
+    QStringList keys, sections;
+    QVector<Action> keyActions, sectionActions;
+    bool keepKeys = false, keepSections = false;
+    for (int lineNumber = 1; !in.atEnd(); ++lineNumber)
+    {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#') || line.startsWith(';')) continue;
+
+        const int pos = line.indexOf(':');
+        const QString rule  = -1 != pos ? line.left(pos).trimmed().toLower() : QString();
+        const QString value = line.mid(pos + 1).trimmed();
+
+        if ("keep" == rule || "drop" == rule)
+        {
+            keys.append(value);
+            keyActions.append("keep" == rule ? Keep : Drop);
+        }
+        else if ("keep-section" == rule || "drop-section" == rule)
+        {
+            sections.append(value);
+            sectionActions.append("keep-section" == rule ? Keep : Drop);
+        }
+        else if ("default" == rule && ("keep" == value.toLower() || "drop" == value.toLower()))
+        {
+            keepKeys = "keep" == value.toLower();
+        }
+        else if ("default-section" == rule && ("keep" == value.toLower() || "drop" == value.toLower()))
+        {
+            keepSections = "keep" == value.toLower();
+        }
+        else
+        {
+            if (error) *error = QString("\"%1\", line %2: invalid rule.").arg(fileName).arg(lineNumber);
+            return false;
+        }
+    }
+
+    _keys.compile(keys, keyActions);
+    _sections.compile(sections, sectionActions);
+    _keepKeys = keepKeys;
+    _keepSections = keepSections;
+    return true;
+}
+
+bool HeaderPolicy::keepKey(const QString& key) const
+{
+    const Action action = _keys.find(key);
+    return Unknown == action ? _keepKeys : Keep == action;
+}
+
+bool HeaderPolicy::keepSection(const QString& name) const
+{
+    const Action action = _sections.find(name);
+    return Unknown == action ? _keepSections : Keep == action;
+}
+
+//
+// Идеальная хэш-таблица
+//
+HeaderPolicy::Table::Table() :
+    _seed(0),
+    _mask(0)
+{}
+
+uint HeaderPolicy::Table::hash(const QString& key, const uint seed)
+{
+    // FNV-1a по символам в нижнем регистре, без временных строк
+    uint h = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (const QChar c : key)
+    {
+        h ^= c.toLower().unicode();
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    return h;
+}
+
+void HeaderPolicy::Table::compile(const QStringList& keys, const QVector<Action>& actions)
+{
+    // Повторы: побеждает последнее правило
+    QStringList uniqueKeys;
+    QVector<Action> uniqueActions;
+    for (int i = 0, len = keys.length(); i < len; ++i)
+    {
+        int index = uniqueKeys.length() - 1;
+        while (index >= 0 && 0 != uniqueKeys.at(index).compare(keys.at(i), Qt::CaseInsensitive)) --index;
+
+        if (-1 == index)
+        {
+            uniqueKeys.append(keys.at(i));
+            uniqueActions.append(actions.at(i));
+        }
+        else
+        {
+            uniqueActions[index] = actions.at(i);
+        }
+    }
+
+    _keys.clear();
+    _actions.clear();
+    _seed = 0;
+    _mask = 0;
+    if (uniqueKeys.isEmpty()) return;
+
+    // Подбираем размер и затравку без коллизий
+    uint size = 2;
+    while (size < 2u * uniqueKeys.length()) size <<= 1;
+
+    for (;; size <<= 1)
+    {
+        for (uint seed = 0; seed < 1024u; ++seed)
+        {
+            QVector<bool> used(size, false);
+            bool collision = false;
+            for (const QString& key : qAsConst(uniqueKeys))
+            {
+                const uint slot = hash(key, seed) & (size - 1);
+                if (used.at(slot))
+                {
+                    collision = true;
+                    break;
+                }
+                used[slot] = true;
+            }
+            if (collision) continue;
+
+            _seed = seed;
+            _mask = size - 1;
+            _actions = QVector<Action>(size, Unknown);
+            for (int i = 0; i < static_cast<int>(size); ++i) _keys.append(QString());
+            for (int i = 0, len = uniqueKeys.length(); i < len; ++i)
+            {
+                const uint slot = hash(uniqueKeys.at(i), seed) & _mask;
+                _keys[slot] = uniqueKeys.at(i);
+                _actions[slot] = uniqueActions.at(i);
+            }
+            return;
+        }
+    }
+}
+
+HeaderPolicy::Action HeaderPolicy::Table::find(const QString& key) const
+{
+    if (_actions.isEmpty()) return Unknown;
+
+    const uint slot = hash(key, _seed) & _mask;
+    const Action action = _actions.at(slot);
+    if (Unknown != action && 0 == _keys.at(slot).compare(key, Qt::CaseInsensitive)) return action;
+    return Unknown;
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HEADERPOLICY_H
+#define HEADERPOLICY_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+
+// Правила для строк [Script Info] и неизвестных секций.
+// По умолчанию оставляются только важные для отрисовки строки,
+// файл правил заменяет их целиком:
+//   # комментарий
+//   keep: PlayResX
+//   drop: Title
+//   keep-section: Aegisub Extradata
+//   default: keep|drop
+//   default-section: keep|drop
+class HeaderPolicy
+{
+public:
+    HeaderPolicy();
+
+    bool load(const QString& fileName, QString* error = nullptr);
+
+    bool keepKey(const QString& key) const;
+    bool keepSection(const QString& name) const;
+
+private:
+    enum Action {Unknown, Keep, Drop};
+
+    // Регистронезависимая идеальная хэш-таблица
+    class Table
+    {
+    public:
+        Table();
+
+        void compile(const QStringList& keys, const QVector<Action>& actions);
+        Action find(const QString& key) const;
+
+    private:
+        QStringList     _keys;
+        QVector<Action> _actions;
+        uint            _seed;
+        uint            _mask;
+
+        static uint hash(const QString& key, const uint seed);
+    };
+
+    Table _keys;
+    Table _sections;
+    bool  _keepKeys;
+    bool  _keepSections;
+};
+
+#endif // HEADERPOLICY_H
@@ -0,0 +1,173 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "incremental.h"
+#include "script.h"
+#include "trace.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+
+namespace Incremental
+{
+namespace
+{
+const quint32 magic = 0x53434958; // "SCIX"
+const quint16 version = 2;
+const QDataStream::Version streamVersion = QDataStream::Qt_5_6;
+
+// Граница блока - после строки события с подходящим хешем: вставка или
+// удаление строки сдвигает только соседние границы. Размер блока ограничен.
+const uint boundaryMask = 63;
+const int maxBlockEvents = 1024;
+
+// FNV-1a по UTF-16: в отличие от qHash, не зависит от версии Qt и запуска
+quint32 StableHash(const QString& line)
+{
+    quint32 hash = 2166136261u;
+    for (const QChar c : line)
+    {
+        hash = (hash ^ c.unicode()) * 16777619u;
+    }
+    return hash;
+}
+
+void AddLine(QCryptographicHash& hash, const QString& line)
+{
+    hash.addData( line.toUtf8() );
+    hash.addData("\n", 1);
+}
+
+// Имена сравниваются через toLower(), как в парсере
+bool IsEvent(const QString& line)
+{
+    const int pos = line.indexOf(':');
+    return -1 != pos && "dialogue" == line.left(pos).trimmed().toLower();
+}
+}
+
+bool Split(const QString& text, Layout& layout)
+{
+    static const QRegularExpression reSection("^\\[([^\\]]+?)\\]$");
+    Trace::Span span("split");
+
+    layout.blocks.clear();
+    QCryptographicHash rest(QCryptographicHash::Sha1);
+
+    // Строки читаются так же, как в парсере SSA
+    QString source = text, line;
+    QTextStream in(&source, QIODevice::ReadOnly);
+    QStringList pending;
+    int pendingEvents = 0, lastEvent = -1, sections = 0;
+    bool inEvents = false;
+
+    auto closeBlock = [&]() {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        Block block;
+        block.events = pendingEvents;
+        block.lines = pending.mid(0, lastEvent + 1);
+        for (const QString& blockLine : qAsConst(block.lines)) AddLine(hash, blockLine);
+        block.hash = hash.result();
+        layout.blocks.append(block);
+
+        pending = pending.mid(lastEvent + 1);
+        pendingEvents = 0;
+        lastEvent = -1;
+    };
+
+    auto closeSection = [&]() {
+        if (pendingEvents) closeBlock();
+        for (const QString& restLine : qAsConst(pending)) AddLine(rest, restLine);
+        pending.clear();
+        inEvents = false;
+    };
+
+    while ( !in.atEnd() )
+    {
+        line = in.readLine().trimmed();
+
+        QRegularExpressionMatch match;
+        if ( line.startsWith('[') && (match = reSection.match(line)).hasMatch() )
+        {
+            if (inEvents) closeSection();
+            if ( Script::Sections::events.toLower() == match.captured(1).trimmed().toLower() )
+            {
+                inEvents = true;
+                ++sections;
+            }
+            AddLine(rest, line);
+        }
+        else if (!inEvents)
+        {
+            AddLine(rest, line);
+        }
+        else
+        {
+            pending.append(line);
+            if ( IsEvent(line) )
+            {
+                ++pendingEvents;
+                lastEvent = pending.length() - 1;
+                if (0 == (StableHash(line) & boundaryMask) || pendingEvents >= maxBlockEvents) closeBlock();
+            }
+        }
+    }
+    if (inEvents) closeSection();
+
+    layout.restHash = rest.result();
+    return 1 == sections;
+}
+
+QByteArray Hash(const QByteArray& data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+bool Load(const QString& fileName, Index& index)
+{
+    QFile file(fileName);
+    if ( !file.open(QFile::ReadOnly) ) return false;
+
+    QDataStream in(&file);
+    in.setVersion(streamVersion);
+
+    quint32 fileMagic;
+    quint16 fileVersion;
+    in >> fileMagic >> fileVersion;
+    if (magic != fileMagic || version != fileVersion) return false;
+
+    in >> index.key >> index.restHash >> index.outputHash >> index.headSize >> index.tailSize
+       >> index.blockHashes >> index.blockSizes;
+    return QDataStream::Ok == in.status() && index.blockHashes.length() == index.blockSizes.length();
+}
+
+bool Save(const QString& fileName, const Index& index)
+{
+    QFile file(fileName);
+    if ( !file.open(QFile::WriteOnly) ) return false;
+
+    QDataStream out(&file);
+    out.setVersion(streamVersion);
+    out << magic << version;
+    out << index.key << index.restHash << index.outputHash << index.headSize << index.tailSize
+        << index.blockHashes << index.blockSizes;
+    return QDataStream::Ok == out.status();
+}
+}
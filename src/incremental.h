@@ -0,0 +1,69 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <QByteArray>
+#include <QStringList>
+#include <QList>
+
+// Повторная очистка изменённого файла. Секция событий режется на блоки
+// по содержимому строк; рядом с выводом хранится индекс: хеши блоков
+// и размеры их вывода. Блоки, хеш которых уже есть в индексе, копируются
+// из старого вывода, остальные чистятся заново.
+namespace Incremental
+{
+const QString suffix = ".scidx";
+
+// Строки от конца предыдущего блока до последней строки Dialogue включительно
+struct Block
+{
+    QByteArray  hash;
+    int         events;
+    QStringList lines;
+};
+
+// Текст SSA/ASS: блоки событий и хеш всего остального
+struct Layout
+{
+    QByteArray   restHash;
+    QList<Block> blocks;
+};
+
+// Индекс последнего вывода
+struct Index
+{
+    QByteArray        key;        // Параметры запуска и форматы
+    QByteArray        restHash;
+    QByteArray        outputHash;
+    qint64            headSize;
+    qint64            tailSize;
+    QList<QByteArray> blockHashes;
+    QList<qint64>     blockSizes;
+};
+
+// false - в тексте не ровно одна секция событий
+bool Split(const QString& text, Layout& layout);
+QByteArray Hash(const QByteArray& data);
+
+bool Load(const QString& fileName, Index& index);
+bool Save(const QString& fileName, const Index& index);
+}
+
+#endif // INCREMENTAL_H
@@ -0,0 +1,145 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "litescript.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+const char* const usage =
+    "Usage: SubCleanerLite [-c|--strip-comments] [-i|--strip-info] input [output]\n"
+    "Strips fonts, graphics and unknown sections from UTF-8 SSA/ASS files.\n"
+    "Other encodings, SRT and the remaining options need SubCleaner.\n";
+
+void Fail(const std::string& message)
+{
+    fprintf(stderr, "%s\n", message.c_str());
+    ::exit(EXIT_FAILURE);
+}
+
+std::string ToLower(std::string s)
+{
+    for (char& c : s)
+    {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return s;
+}
+
+// Как QFileInfo: каталог, имя без последнего суффикса и суффикс
+void SplitPath(const std::string& path, std::string& dir, std::string& baseName, std::string& suffix)
+{
+    const size_t slash = path.find_last_of("/\\");
+    dir = std::string::npos != slash ? path.substr(0, slash + 1) : std::string();
+
+    const std::string name = path.substr(dir.size());
+    const size_t dot = name.rfind('.');
+    baseName = name.substr(0, dot);
+    suffix = std::string::npos != dot ? name.substr(dot + 1) : std::string();
+}
+
+Lite::ScriptType FormatFromSuffix(const std::string& suffix)
+{
+    const std::string lower = ToLower(suffix);
+    if ("ass" == lower) return Lite::SCR_ASS;
+    if ("ssa" == lower) return Lite::SCR_SSA;
+    return Lite::SCR_UNKNOWN;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    bool stripComments = false, stripInfo = false;
+    std::string inputFile, outputFile;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if      ("-c" == arg || "--strip-comments" == arg) stripComments = true;
+        else if ("-i" == arg || "--strip-info" == arg)     stripInfo = true;
+        else if ("-h" == arg || "--help" == arg)
+        {
+            fputs(usage, stdout);
+            return EXIT_SUCCESS;
+        }
+        else if (!arg.empty() && '-' == arg[0])
+        {
+            Fail("Unknown option: " + arg);
+        }
+        else if (inputFile.empty())  inputFile = arg;
+        else if (outputFile.empty()) outputFile = arg;
+        else Fail("Too many arguments.");
+    }
+
+    if (inputFile.empty())
+    {
+        fputs(usage, stderr);
+        return EXIT_FAILURE;
+    }
+
+    std::string dir, baseName, suffix;
+    SplitPath(inputFile, dir, baseName, suffix);
+    if (outputFile.empty())
+    {
+        outputFile = dir + baseName + ".clean";
+        if (!suffix.empty()) outputFile += "." + suffix;
+    }
+
+    // Чтение
+    std::ifstream in(inputFile, std::ios::binary);
+    if (!in) Fail("Can't open file \"" + inputFile + "\".");
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (in.bad()) Fail("Can't read file \"" + inputFile + "\".");
+
+    if (0 == text.compare(0, 3, "\xEF\xBB\xBF")) text.erase(0, 3);
+    if ( !Lite::IsUtf8(text.data(), text.size()) ) Fail("Input file is not UTF-8, use SubCleaner.");
+
+    const Lite::ScriptType inputType = Lite::DetectFormat(text.data(), text.size());
+    if (Lite::SCR_UNKNOWN == inputType) Fail("File format is unknown, use SubCleaner.");
+
+    // Формат вывода - по расширению, иначе как у входного файла
+    std::string outputDir, outputBaseName, outputSuffix;
+    SplitPath(outputFile, outputDir, outputBaseName, outputSuffix);
+    Lite::ScriptType outputType = FormatFromSuffix(outputSuffix);
+    if (Lite::SCR_UNKNOWN == outputType)
+    {
+        if ("srt" == ToLower(outputSuffix)) Fail("SRT output is not supported, use SubCleaner.");
+        outputType = inputType;
+    }
+
+    // Очистка
+    Lite::Script script;
+    if ( !Lite::ParseSSA(text, script) ) Fail("Not an SSA/ASS file.");
+    text.clear();
+
+    Lite::StripAttachments(script);
+    if (stripComments) Lite::StripComments(script);
+    if (stripInfo)     Lite::StripInfo(script);
+
+    // Запись
+    std::ofstream out(outputFile, std::ios::binary | std::ios::trunc);
+    if (!out) Fail("Can't open file \"" + outputFile + "\".");
+    out << "\xEF\xBB\xBF" << Lite::Generate(script, outputType);
+    out.close();
+    if (!out) Fail("Can't write file \"" + outputFile + "\".");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,942 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "litescript.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace Lite
+{
+namespace
+{
+const uint16_t AlignmentSSA[] = {0, 1, 2, 3, 0, 7, 8, 9, 0, 4, 5, 6};
+const uint16_t AlignmentASS[] = {0, 1, 2, 3, 9, 10, 11, 5, 6, 7};
+
+const char* const importantLines[] = {"wrapstyle", "playresx", "playresy", "scaledborderandshadow", "ycbcr matrix"};
+
+//
+// Строки в UTF-8
+//
+
+// Пробелы по QChar::isSpace()
+bool IsSpace(const uint32_t cp)
+{
+    return 0x20 == cp || (cp >= 0x09 && cp <= 0x0D) || 0x85 == cp || 0xA0 == cp || 0x1680 == cp ||
+           (cp >= 0x2000 && cp <= 0x200A) || 0x2028 == cp || 0x2029 == cp || 0x202F == cp || 0x205F == cp || 0x3000 == cp;
+}
+
+// Текст уже проверен на корректность UTF-8; обрезанный символ читается как байт
+uint32_t Decode(const char* data, const size_t size, const size_t pos, size_t& len)
+{
+    const unsigned char c = static_cast<unsigned char>(data[pos]);
+    uint32_t cp;
+    if      (c < 0x80)           { len = 1; cp = c; }
+    else if (0xC0 == (c & 0xE0)) { len = 2; cp = c & 0x1F; }
+    else if (0xE0 == (c & 0xF0)) { len = 3; cp = c & 0x0F; }
+    else                         { len = 4; cp = c & 0x07; }
+    if (pos + len > size)
+    {
+        len = 1;
+        return c;
+    }
+    for (size_t i = 1; i < len; ++i) cp = cp << 6 | (static_cast<unsigned char>(data[pos + i]) & 0x3F);
+    return cp;
+}
+
+// Границы строки без пробелов по краям, как у QString::trimmed()
+void TrimSpan(const char* data, size_t& begin, size_t& end)
+{
+    size_t len;
+    while (begin < end && IsSpace( Decode(data, end, begin, len) )) begin += len;
+    while (end > begin)
+    {
+        size_t last = end - 1;
+        while (last > begin && 0x80 == (static_cast<unsigned char>(data[last]) & 0xC0)) --last;
+        if ( !IsSpace(Decode(data, end, last, len)) ) break;
+        end = last;
+    }
+}
+
+std::string Trimmed(const std::string& s)
+{
+    size_t begin = 0, end = s.size();
+    TrimSpan(s.data(), begin, end);
+    return s.substr(begin, end - begin);
+}
+
+// Имена секций и строк сравниваются в нижнем регистре ASCII
+std::string ToLower(std::string s)
+{
+    for (char& c : s)
+    {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return s;
+}
+
+bool StartsWith(const std::string& s, const char* prefix)
+{
+    return 0 == s.compare(0, std::strlen(prefix), prefix);
+}
+
+// Как QString::split(): пустые части сохраняются
+Lines Split(const std::string& s, const char separator)
+{
+    Lines result;
+    size_t begin = 0;
+    for (size_t pos = s.find(separator); std::string::npos != pos; pos = s.find(separator, begin))
+    {
+        result.push_back(s.substr(begin, pos - begin));
+        begin = pos + 1;
+    }
+    result.push_back(s.substr(begin));
+    return result;
+}
+
+std::string Join(const Lines& lines, const std::string& separator, const size_t from = 0)
+{
+    std::string result;
+    for (size_t i = from; i < lines.size(); ++i)
+    {
+        if (i > from) result += separator;
+        result += lines[i];
+    }
+    return result;
+}
+
+// "[Имя]" без "]" внутри
+bool IsSection(const std::string& line, std::string& name)
+{
+    if (line.size() < 3 || '[' != line.front() || ']' != line.back()) return false;
+    name = line.substr(1, line.size() - 2);
+    return std::string::npos == name.find(']');
+}
+
+//
+// Числа, как их разбирает и печатает QString
+//
+bool ParseUnsigned(const std::string& s, const unsigned base, const uint64_t max, uint64_t& value)
+{
+    size_t i = 0;
+    if (i < s.size() && '+' == s[i]) ++i;
+    if (16 == base && i + 1 < s.size() && '0' == s[i] && ('x' == s[i + 1] || 'X' == s[i + 1])) i += 2;
+    if (i == s.size()) return false;
+
+    value = 0;
+    for (; i < s.size(); ++i)
+    {
+        const char c = s[i];
+        unsigned digit;
+        if      (c >= '0' && c <= '9')              digit = static_cast<unsigned>(c - '0');
+        else if (16 == base && c >= 'a' && c <= 'f') digit = static_cast<unsigned>(c - 'a' + 10);
+        else if (16 == base && c >= 'A' && c <= 'F') digit = static_cast<unsigned>(c - 'A' + 10);
+        else return false;
+
+        if (value > (max - digit) / base) return false;
+        value = value * base + digit;
+    }
+    return true;
+}
+
+// Пробелы по краям числа QString пропускает
+uint32_t ToUInt(const std::string& s, const unsigned base = 10)
+{
+    uint64_t value;
+    return ParseUnsigned(Trimmed(s), base, std::numeric_limits<uint32_t>::max(), value) ? static_cast<uint32_t>(value) : 0;
+}
+
+uint16_t ToUShort(const std::string& s)
+{
+    uint64_t value;
+    return ParseUnsigned(Trimmed(s), 10, std::numeric_limits<uint16_t>::max(), value) ? static_cast<uint16_t>(value) : 0;
+}
+
+int32_t ToInt(const std::string& str)
+{
+    const std::string s = Trimmed(str);
+    const bool negative = !s.empty() && '-' == s[0];
+    if (negative && s.size() > 1 && '+' == s[1]) return 0;
+
+    uint64_t value;
+    if ( !ParseUnsigned(negative ? s.substr(1) : s, 10, negative ? 0x80000000u : 0x7FFFFFFFu, value) ) return 0;
+    return negative ? static_cast<int32_t>(-static_cast<int64_t>(value)) : static_cast<int32_t>(value);
+}
+
+double ToDouble(const std::string& str)
+{
+    const std::string s = Trimmed(str);
+    if ( s.empty() || std::string::npos != s.find_first_not_of("0123456789+-.eEinfaINFA") ) return 0.0;
+
+    char* end = nullptr;
+    const double value = std::strtod(s.c_str(), &end);
+    return end == s.c_str() + s.size() ? value : 0.0;
+}
+
+std::string Number(const double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.10g", value);
+    return buffer;
+}
+
+std::string Number(const uint64_t value)
+{
+    return std::to_string(value);
+}
+
+// Layer в ASS или Marked=N в SSA: остаются только цифры
+uint32_t ParseLayer(const std::string& field)
+{
+    std::string digits;
+    for (const char c : field)
+    {
+        if (c >= '0' && c <= '9') digits += c;
+    }
+    return ToUInt(digits);
+}
+
+uint32_t ParseColour(const std::string& field)
+{
+    const std::string value = Trimmed(field);
+    if ( StartsWith(value, "&H") ) return ToUInt(value.substr(2), 16);
+    return static_cast<uint32_t>( ToInt(value) );
+}
+
+// Номер подстановки %N или %LN (0-99) в позиции i; 0 - не подстановка
+size_t ArgEscape(const std::string& pattern, const size_t i, int& number)
+{
+    if ('%' != pattern[i]) return 0;
+
+    size_t j = i + 1;
+    if (j < pattern.size() && 'L' == pattern[j]) ++j;
+    if (j >= pattern.size() || pattern[j] < '0' || pattern[j] > '9') return 0;
+
+    number = pattern[j++] - '0';
+    if (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') number = number * 10 + pattern[j++] - '0';
+    return j - i;
+}
+
+// Подстановка как у QString::arg(): заменяется наименьший номер, везде
+std::string Arg(const std::string& pattern, const std::string& value)
+{
+    int lowest = 100, number;
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        if (ArgEscape(pattern, i, number) && number < lowest) lowest = number;
+    }
+    if (100 == lowest) return pattern;
+
+    std::string result;
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        const size_t len = ArgEscape(pattern, i, number);
+        if (len && number == lowest)
+        {
+            result += value;
+            i += len - 1;
+        }
+        else
+        {
+            result += pattern[i];
+        }
+    }
+    return result;
+}
+
+void AppendLines(std::string& result, const Lines& lines)
+{
+    for (const std::string& line : lines)
+    {
+        result += line;
+        result += "\n";
+    }
+}
+
+void AppendStyle(std::string& result, const Style& s, const ScriptType type)
+{
+    AppendLines(result, s.before);
+    result += NamedLine("Style", StyleFields(s, type));
+    result += "\n";
+}
+
+// Нетронутая строка выводится как есть
+void AppendEvent(std::string& result, const Event& e, const ScriptType type)
+{
+    AppendLines(result, e.before);
+    if (type == e.rawType) result += e.rawPrefix;
+    else                   result += NamedLine("Dialogue", EventFields(e, type));
+    result += e.text;
+    result += "\n";
+}
+
+//
+// Разбор
+//
+void ParseStyleFields(const Lines& list, Style& s, const ScriptType type)
+{
+    size_t i = 0;
+    auto next = [&list, &i](std::string& value) {
+        if (i >= list.size()) return false;
+        value = list[i++];
+        return true;
+    };
+
+    std::string value;
+    if ( next(value) ) s.styleName = Trimmed(value);
+    if ( next(value) ) s.fontName = Trimmed(value);
+    if ( next(value) ) s.fontSize = ToDouble(value);
+    if ( next(value) ) s.primaryColour = ParseColour(value);
+    if ( next(value) ) s.secondaryColour = ParseColour(value);
+    if ( next(value) ) s.outlineColour = ParseColour(value);
+    if ( next(value) ) s.backColour = ParseColour(value);
+    if ( next(value) ) s.bold = 0 != ToInt(value);
+    if ( next(value) ) s.italic = 0 != ToInt(value);
+
+    if (SCR_ASS == type)
+    {
+        if ( next(value) ) s.underline = 0 != ToInt(value);
+        if ( next(value) ) s.strikeOut = 0 != ToInt(value);
+        if ( next(value) ) s.scaleX = ToDouble(value);
+        if ( next(value) ) s.scaleY = ToDouble(value);
+        if ( next(value) ) s.spacing = ToDouble(value);
+        if ( next(value) ) s.angle = ToDouble(value);
+    }
+
+    if ( next(value) ) s.borderStyle = ToUShort(value);
+    if ( next(value) ) s.outline = ToDouble(value);
+    if ( next(value) ) s.shadow = ToDouble(value);
+
+    if ( next(value) )
+    {
+        s.alignment = ToUShort(value);
+        if (SCR_SSA == type && s.alignment > 0 && s.alignment < sizeof(AlignmentSSA) / sizeof(AlignmentSSA[0]))
+        {
+            s.alignment = AlignmentSSA[s.alignment];
+        }
+        if (s.alignment < 1 || s.alignment > 9) s.alignment = 2;
+    }
+
+    if ( next(value) ) s.marginL = ToUShort(value);
+    if ( next(value) ) s.marginR = ToUShort(value);
+    if ( next(value) ) s.marginV = ToUShort(value);
+
+    // AlphaLevel
+    if (SCR_SSA == type) next(value);
+
+    if ( next(value) ) s.encoding = ToUShort(value);
+}
+
+// Сборка модели Lite
+class ScriptBuilder : public Handler
+{
+public:
+    explicit ScriptBuilder(Script& script) :
+        _script(script)
+    {}
+
+    void before(Lines& lines) override
+    {
+        _script.before.insert(_script.before.end(), lines.begin(), lines.end());
+    }
+
+    void header(Named& line) override
+    {
+        _script.header.content.push_back(Named());
+        std::swap(_script.header.content.back(), line);
+    }
+
+    void style(Style& line) override
+    {
+        _script.styles.content.push_back(line);
+    }
+
+    void event(Lines& before, const std::string& line, const size_t colon) override
+    {
+        _script.events.content.push_back(Event());
+        Event& e = _script.events.content.back();
+        e.before.swap(before);
+        ParseEvent(line, colon, e);
+    }
+
+    void sectionAfter(const SectionType section, Lines& lines) override
+    {
+        Lines& after = SEC_HEADER == section ? _script.header.after :
+                       SEC_STYLES == section ? _script.styles.after : _script.events.after;
+        after.insert(after.end(), lines.begin(), lines.end());
+    }
+
+    void extra(const std::string& name) override
+    {
+        _script.extra.push_back({name, Lines()});
+    }
+
+    void content(const SectionType section, std::string& line) override
+    {
+        Lines& lines = SEC_FONTS == section ? _script.fonts :
+                       SEC_GRAPHICS == section ? _script.graphics : _script.extra.back().content;
+        lines.push_back(std::string());
+        lines.back().swap(line);
+    }
+
+    void after(Lines& lines) override
+    {
+        _script.after.insert(_script.after.end(), lines.begin(), lines.end());
+    }
+
+private:
+    Script& _script;
+};
+}
+
+Style::Style() :
+    styleName("Default"),
+    fontName("Arial"),
+    fontSize(20.0),
+    primaryColour(0xFFFFFF),
+    secondaryColour(0xFF),
+    outlineColour(0),
+    backColour(0),
+    bold(false),
+    italic(false),
+    underline(false),
+    strikeOut(false),
+    scaleX(100.0),
+    scaleY(100.0),
+    spacing(0.0),
+    angle(0.0),
+    borderStyle(1),
+    outline(2.0),
+    shadow(2.0),
+    alignment(2),
+    marginL(10),
+    marginR(10),
+    marginV(10),
+    encoding(1)
+{}
+
+Event::Event() :
+    layer(0),
+    start(0),
+    end(0),
+    style("Default"),
+    marginL(0),
+    marginR(0),
+    marginV(0),
+    rawType(SCR_UNKNOWN)
+{}
+
+Handler::~Handler()
+{}
+
+bool IsUtf8(const char* data, const size_t len)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + len;
+
+    while (p < end)
+    {
+        const unsigned char c = *p;
+        if (c < 0x80)
+        {
+            ++p;
+            continue;
+        }
+
+        int n;
+        uint32_t min, cp;
+        if      (0xC0 == (c & 0xE0)) { n = 1; min = 0x80;    cp = c & 0x1F; }
+        else if (0xE0 == (c & 0xF0)) { n = 2; min = 0x800;   cp = c & 0x0F; }
+        else if (0xF0 == (c & 0xF8)) { n = 3; min = 0x10000; cp = c & 0x07; }
+        else return false;
+
+        if (end - p <= n) return false;
+        for (int i = 1; i <= n; ++i)
+        {
+            if (0x80 != (p[i] & 0xC0)) return false;
+            cp = cp << 6 | (p[i] & 0x3F);
+        }
+
+        // Слишком длинные последовательности и суррогаты
+        if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return false;
+        p += n + 1;
+    }
+
+    return true;
+}
+
+// Как Script::DetectFormat(): смотрим первые 5120 символов UTF-16, SRT не ищем
+ScriptType DetectFormat(const char* data, const size_t len)
+{
+    size_t limit = 0, charLen;
+    for (int units = 0; limit < len && units < 5120; limit += charLen)
+    {
+        units += Decode(data, len, limit, charLen) > 0xFFFF ? 2 : 1;
+    }
+    const std::string head(data, limit);
+
+    // "ScriptType *: *v4\.00\+?"
+    ScriptType result = SCR_UNKNOWN;
+    for (size_t pos = head.find("ScriptType"); std::string::npos != pos; pos = head.find("ScriptType", pos + 1))
+    {
+        size_t i = pos + 10;
+        while (i < head.size() && ' ' == head[i]) ++i;
+        if (i >= head.size() || ':' != head[i]) continue;
+        ++i;
+        while (i < head.size() && ' ' == head[i]) ++i;
+        if (0 != head.compare(i, 5, "v4.00")) continue;
+
+        if (i + 5 < head.size() && '+' == head[i + 5]) return SCR_ASS;
+        result = SCR_SSA;
+    }
+    return result;
+}
+
+// Строки режутся по '\n', как у QTextStream::readLine(), и обрезаются как QString::trimmed()
+void ParseSSA(const char* data, const size_t len, Handler& handler)
+{
+    enum State {ST_UNKNOWN, ST_HEADER, ST_STYLES, ST_EVENTS, ST_FONTS, ST_GRAPHICS, ST_EXTRA};
+
+    State state = ST_UNKNOWN;
+    ScriptType type = SCR_SSA;
+    Lines pending;
+    std::string line, section, name, value;
+    bool readNext = true, atBegin = true;
+    size_t pos = 0;
+    while (pos < len)
+    {
+        // Если вернулись из секции, имя новой секции надо сохранить
+        if (readNext)
+        {
+            const char* const newline = static_cast<const char*>( std::memchr(data + pos, '\n', len - pos) );
+            size_t begin = pos, end = newline ? static_cast<size_t>(newline - data) : len;
+            pos = newline ? end + 1 : len;
+            TrimSpan(data, begin, end);
+            line.assign(data + begin, end - begin);
+        }
+        else
+        {
+            readNext = true;
+        }
+
+        // Пропускаем пустые строки, чтобы не делать проверки дальше
+        if (!atBegin && line.empty()) continue;
+
+        const bool isSection = IsSection(line, section);
+
+        // Началась другая секция: строка разбирается заново вне секций
+        if (ST_UNKNOWN != state && isSection)
+        {
+            if      (ST_HEADER == state) handler.sectionAfter(SEC_HEADER, pending);
+            else if (ST_STYLES == state) handler.sectionAfter(SEC_STYLES, pending);
+            else if (ST_EVENTS == state) handler.sectionAfter(SEC_EVENTS, pending);
+            pending.clear();
+
+            readNext = false;
+            state = ST_UNKNOWN;
+            continue;
+        }
+
+        const size_t colon = line.find(':');
+        switch (state)
+        {
+        case ST_UNKNOWN:
+            if (isSection)
+            {
+                const std::string lower = ToLower( Trimmed(section) );
+                State next = ST_UNKNOWN;
+                if      ("script info" == lower) next = ST_HEADER;
+                else if ("v4 styles" == lower)   { next = ST_STYLES; type = SCR_SSA; }
+                else if ("v4+ styles" == lower)  { next = ST_STYLES; type = SCR_ASS; }
+                else if ("events" == lower)      next = ST_EVENTS;
+                else if ("fonts" == lower)       next = ST_FONTS;
+                else if ("graphics" == lower)    next = ST_GRAPHICS;
+
+                if (ST_UNKNOWN != next)
+                {
+                    state = next;
+                    if (atBegin)
+                    {
+                        atBegin = false;
+                        handler.before(pending);
+                        pending.clear();
+                    }
+                }
+                // Неизвестная секция (например, Aegisub Project Garbage)
+                else if (!atBegin)
+                {
+                    handler.extra( Trimmed(section) );
+                    state = ST_EXTRA;
+                }
+            }
+            break;
+
+        case ST_HEADER:
+            // Такой комментарий может быть только в заголовке
+            if ( StartsWith(line, ";") || std::string::npos == colon )
+            {
+                pending.push_back(line);
+            }
+            else
+            {
+                name = Trimmed( line.substr(0, colon) );
+                value = Trimmed( line.substr(colon + 1) );
+
+                // Версия файла
+                if ("scripttype" == ToLower(name))
+                {
+                    const std::string lower = ToLower(value);
+                    if      ("v4.00" == lower || "v4 styles" == lower)   type = SCR_SSA;
+                    else if ("v4.00+" == lower || "v4+ styles" == lower) type = SCR_ASS;
+                }
+                else
+                {
+                    Named named;
+                    named.before.swap(pending);
+                    named.name = name;
+                    named.text = value;
+                    handler.header(named);
+                    pending.clear();
+                }
+            }
+            break;
+
+        case ST_STYLES:
+        case ST_EVENTS:
+            if (std::string::npos == colon)
+            {
+                pending.push_back(line);
+                break;
+            }
+
+            name = ToLower( Trimmed(line.substr(0, colon)) );
+            if (ST_STYLES == state && "style" == name)
+            {
+                Style s;
+                s.before.swap(pending);
+                ParseStyleFields(Split(Trimmed(line.substr(colon + 1)), ','), s, type);
+                handler.style(s);
+                pending.clear();
+            }
+            else if (ST_EVENTS == state && "dialogue" == name)
+            {
+                handler.event(pending, line, colon);
+                pending.clear();
+            }
+            // Строка формата пропускается, остальное - мусор
+            else if ("format" != name)
+            {
+                pending.push_back(line);
+            }
+            break;
+
+        case ST_FONTS:
+            handler.content(SEC_FONTS, line);
+            break;
+
+        case ST_GRAPHICS:
+            handler.content(SEC_GRAPHICS, line);
+            break;
+
+        case ST_EXTRA:
+            handler.content(SEC_EXTRA, line);
+            break;
+        }
+    }
+
+    // Спасаем мусор в конце файла
+    if (!pending.empty()) handler.after(pending);
+}
+
+bool ParseSSA(const std::string& text, Script& script)
+{
+    ScriptBuilder builder(script);
+    ParseSSA(text.data(), text.size(), builder);
+    return true;
+}
+
+void ParseEvent(const std::string& line, const size_t colon, Event& e)
+{
+    const Lines list = Split(Trimmed(line.substr(colon + 1)), ',');
+    size_t i = 0;
+
+    e.layer = ParseLayer(list[i++]);
+    if (i < list.size()) e.start = StrToTime(list[i++]);
+    if (i < list.size()) e.end = StrToTime(list[i++]);
+    if (i < list.size()) e.style = Trimmed(list[i++]);
+    if (i < list.size()) e.actorName = Trimmed(list[i++]);
+    if (i < list.size()) e.marginL = ToUShort(list[i++]);
+    if (i < list.size()) e.marginR = ToUShort(list[i++]);
+    if (i < list.size()) e.marginV = ToUShort(list[i++]);
+    if (i < list.size()) e.effect = Trimmed(list[i++]);
+    if (i < list.size()) e.text = Join(list, ",", i);
+
+    // Все поля на месте - строка до текста выводится как есть
+    size_t textPos;
+    e.rawType = SplitEvent(line, colon, textPos);
+    if (SCR_UNKNOWN != e.rawType)
+    {
+        e.rawPrefix = line.substr(0, textPos + 1);
+    }
+    else
+    {
+        e.rawPrefix.clear();
+    }
+}
+
+// Формат строки определяется по первому полю: "Marked=N" в SSA, число в ASS
+ScriptType SplitEvent(const std::string& line, const size_t colon, size_t& textPos)
+{
+    textPos = colon;
+    for (int n = 0; n < 9 && std::string::npos != textPos; ++n) textPos = line.find(',', textPos + 1);
+    if (std::string::npos == textPos) return SCR_UNKNOWN;
+
+    const size_t comma = line.find(',', colon + 1);
+    const std::string first = Trimmed( line.substr(colon + 1, comma - colon - 1) );
+    if ( StartsWith(first, "Marked=") ) return SCR_SSA;
+    if ( !first.empty() && std::string::npos == first.find_first_not_of("0123456789") ) return SCR_ASS;
+    return SCR_UNKNOWN;
+}
+
+// Чисел может недоставать с конца
+uint32_t StrToTime(const std::string& str)
+{
+    const Lines list = Split(str, ':');
+    uint32_t hour = ToUInt(list[0]), min = 0, sec = 0, msec = 0;
+    if (list.size() > 1) min = ToUInt(list[1]);
+    if (list.size() > 2)
+    {
+        const Lines parts = Split(list[2], '.');
+        sec = ToUInt(parts[0]);
+        if (parts.size() > 1) msec = ToUInt(parts[1]) * 10u;
+    }
+    return ((hour * 60u + min) * 60u + sec) * 1000u + msec;
+}
+
+std::string TimeToStr(const uint32_t time)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%u:%02u:%02u.%02u",
+                  time / 3600000u, time / 60000u % 60u, time / 1000u % 60u, time % 1000u / 10u);
+    return buffer;
+}
+
+std::string NamedLine(const std::string& name, const std::string& value)
+{
+    return Arg(Arg("%1: %2", name), value);
+}
+
+std::string StyleFields(const Style& s, const ScriptType type)
+{
+    Lines list;
+    list.push_back(s.styleName);
+    list.push_back(s.fontName);
+    list.push_back( Number(s.fontSize) );
+
+    for (const uint32_t colour : {s.primaryColour, s.secondaryColour, s.outlineColour, s.backColour})
+    {
+        if (SCR_ASS == type)
+        {
+            char buffer[16];
+            std::snprintf(buffer, sizeof(buffer), "&H%08X", colour);
+            list.push_back(buffer);
+        }
+        else
+        {
+            list.push_back( std::to_string(static_cast<int32_t>(colour)) );
+        }
+    }
+
+    list.push_back(s.bold   ? "-1" : "0");
+    list.push_back(s.italic ? "-1" : "0");
+
+    if (SCR_ASS == type)
+    {
+        list.push_back(s.underline ? "-1" : "0");
+        list.push_back(s.strikeOut ? "-1" : "0");
+        list.push_back( Number(s.scaleX) );
+        list.push_back( Number(s.scaleY) );
+        list.push_back( Number(s.spacing) );
+        list.push_back( Number(s.angle) );
+    }
+
+    list.push_back( Number(static_cast<uint64_t>(s.borderStyle)) );
+    list.push_back( Number(s.outline) );
+    list.push_back( Number(s.shadow) );
+
+    const bool convert = SCR_SSA == type && s.alignment > 0 && s.alignment < sizeof(AlignmentASS) / sizeof(AlignmentASS[0]);
+    list.push_back( Number(static_cast<uint64_t>(convert ? AlignmentASS[s.alignment] : s.alignment)) );
+
+    list.push_back( Number(static_cast<uint64_t>(s.marginL)) );
+    list.push_back( Number(static_cast<uint64_t>(s.marginR)) );
+    list.push_back( Number(static_cast<uint64_t>(s.marginV)) );
+
+    if (SCR_SSA == type) list.push_back("0");
+
+    list.push_back( Number(static_cast<uint64_t>(s.encoding)) );
+
+    return Join(list, ",");
+}
+
+std::string EventFields(const Event& e, const ScriptType type)
+{
+    std::string result = SCR_SSA == type ? "Marked=" : "";
+    result += Number(static_cast<uint64_t>(e.layer));
+    result += ",";
+    result += TimeToStr(e.start);
+    result += ",";
+    result += TimeToStr(e.end);
+    result += ",";
+    result += e.style;
+    result += ",";
+    result += e.actorName;
+    result += ",";
+    result += Number(static_cast<uint64_t>(e.marginL));
+    result += ",";
+    result += Number(static_cast<uint64_t>(e.marginR));
+    result += ",";
+    result += Number(static_cast<uint64_t>(e.marginV));
+    result += ",";
+    result += e.effect;
+    result += ",";
+    return result;
+}
+
+const char* SectionHead(const SectionType section, const ScriptType type)
+{
+    const bool ass = SCR_ASS == type;
+    switch (section)
+    {
+    case SEC_HEADER:
+        return "[Script Info]\n";
+
+    case SEC_STYLES:
+        return ass ? "[V4+ Styles]\nFormat: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n"
+                   : "[V4 Styles]\nFormat: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, TertiaryColour, BackColour, Bold, Italic, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, AlphaLevel, Encoding\n";
+
+    case SEC_EVENTS:
+        return ass ? "[Events]\nFormat: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+                   : "[Events]\nFormat: Marked, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+
+    case SEC_FONTS:
+        return "[Fonts]\n";
+
+    case SEC_GRAPHICS:
+        return "[Graphics]\n";
+
+    default:
+        return "";
+    }
+}
+
+const char* ScriptTypeLine(const ScriptType type)
+{
+    return SCR_ASS == type ? "ScriptType: v4.00+\n" : "ScriptType: v4.00\n";
+}
+
+void StripComments(Script& script)
+{
+    for (Named& line : script.header.content) line.before.clear();
+    for (Style& line : script.styles.content) line.before.clear();
+    for (Event& line : script.events.content) line.before.clear();
+    script.header.after.clear();
+    script.styles.after.clear();
+    script.events.after.clear();
+    script.before.clear();
+    script.after.clear();
+}
+
+void StripInfo(Script& script)
+{
+    std::vector<Named>& content = script.header.content;
+    size_t kept = 0;
+    for (size_t i = 0; i < content.size(); ++i)
+    {
+        const std::string name = ToLower(content[i].name);
+        bool important = false;
+        for (const char* const key : importantLines) important = important || name == key;
+        if (important) std::swap(content[kept++], content[i]);
+    }
+    content.resize(kept);
+}
+
+void StripAttachments(Script& script)
+{
+    script.fonts.clear();
+    script.graphics.clear();
+    script.extra.clear();
+}
+
+std::string Generate(const Script& script, const ScriptType type)
+{
+    std::string result;
+
+    AppendLines(result, script.before);
+
+    // Заголовок
+    result += SectionHead(SEC_HEADER, type);
+    for (const Named& line : script.header.content)
+    {
+        AppendLines(result, line.before);
+        result += NamedLine(line.name, line.text);
+        result += "\n";
+    }
+    result += ScriptTypeLine(type);
+    AppendLines(result, script.header.after);
+    result += "\n";
+
+    // Стили
+    result += SectionHead(SEC_STYLES, type);
+    for (const Style& s : script.styles.content) AppendStyle(result, s, type);
+    AppendLines(result, script.styles.after);
+    result += "\n";
+
+    // События
+    result += SectionHead(SEC_EVENTS, type);
+    for (const Event& e : script.events.content) AppendEvent(result, e, type);
+    AppendLines(result, script.events.after);
+
+    // Вложения и неизвестные секции
+    if (!script.fonts.empty())
+    {
+        result += "\n";
+        result += SectionHead(SEC_FONTS, type);
+        AppendLines(result, script.fonts);
+    }
+    if (!script.graphics.empty())
+    {
+        result += "\n";
+        result += SectionHead(SEC_GRAPHICS, type);
+        AppendLines(result, script.graphics);
+    }
+    for (const ExtraSection& section : script.extra)
+    {
+        result += "\n[" + section.name + "]\n";
+        AppendLines(result, section.content);
+    }
+
+    if (!script.after.empty())
+    {
+        result += "\n";
+        AppendLines(result, script.after);
+    }
+
+    return result;
+}
+}
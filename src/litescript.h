@@ -0,0 +1,179 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LITESCRIPT_H
+#define LITESCRIPT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Ядро SSA/ASS без Qt: разбор UTF-8, модель строк и их вывод.
+// Полная программа разбирает файл и собирает строки этими же функциями
+// в свою модель (script.h); SubCleanerLite работает прямо с моделью ниже.
+namespace Lite
+{
+enum ScriptType {SCR_UNKNOWN, SCR_ASS, SCR_SSA};
+enum SectionType {SEC_HEADER, SEC_STYLES, SEC_EVENTS, SEC_FONTS, SEC_GRAPHICS, SEC_EXTRA};
+
+typedef std::vector<std::string> Lines;
+
+// Строка "Имя: значение"
+struct Named
+{
+    Lines       before;
+    std::string name;
+    std::string text;
+};
+
+struct Style
+{
+    Lines       before;
+    std::string styleName;
+    std::string fontName;
+    double      fontSize;
+    uint32_t    primaryColour;
+    uint32_t    secondaryColour;
+    uint32_t    outlineColour;
+    uint32_t    backColour;
+    bool        bold;
+    bool        italic;
+    bool        underline;
+    bool        strikeOut;
+    double      scaleX;
+    double      scaleY;
+    double      spacing;
+    double      angle;
+    uint16_t    borderStyle;
+    double      outline;
+    double      shadow;
+    uint16_t    alignment;
+    uint16_t    marginL;
+    uint16_t    marginR;
+    uint16_t    marginV;
+    uint16_t    encoding;
+
+    Style();
+};
+
+struct Event
+{
+    Lines       before;
+    uint32_t    layer;
+    uint32_t    start;
+    uint32_t    end;
+    std::string style;
+    std::string actorName;
+    uint16_t    marginL;
+    uint16_t    marginR;
+    uint16_t    marginV;
+    std::string effect;
+    std::string text;
+    // Исходная строка до текста и её формат: выводится как есть
+    std::string rawPrefix;
+    ScriptType  rawType;
+
+    Event();
+};
+
+template <class T>
+struct Section
+{
+    std::vector<T> content;
+    Lines          after;
+};
+
+struct ExtraSection
+{
+    std::string name;
+    Lines       content;
+};
+
+struct Script
+{
+    Lines                     before;
+    Lines                     after;
+    Section<Named>            header;
+    Section<Style>            styles;
+    Section<Event>            events;
+    Lines                     fonts;
+    Lines                     graphics;
+    std::vector<ExtraSection> extra;
+};
+
+// Приёмник разбора: строки отдаются по мере чтения, списки можно забирать swap()
+class Handler
+{
+public:
+    virtual ~Handler();
+
+    // Строки до первой известной секции
+    virtual void before(Lines& lines) = 0;
+    virtual void header(Named& line) = 0;
+    virtual void style(Style& line) = 0;
+    // Строка Dialogue целиком, colon - позиция двоеточия; поля разбирает ParseEvent()
+    virtual void event(Lines& before, const std::string& line, const size_t colon) = 0;
+    // Нераспознанные строки в конце заголовка, стилей или событий
+    virtual void sectionAfter(const SectionType section, Lines& lines) = 0;
+    // Начало неизвестной секции
+    virtual void extra(const std::string& name) = 0;
+    // Строка шрифтов, графики или неизвестной секции
+    virtual void content(const SectionType section, std::string& line) = 0;
+    // Строки в конце файла
+    virtual void after(Lines& lines) = 0;
+};
+
+// Проверка UTF-8 без BOM
+bool IsUtf8(const char* data, const size_t len);
+ScriptType DetectFormat(const char* data, const size_t len);
+
+// Текст в корректном UTF-8 без BOM
+void ParseSSA(const char* data, const size_t len, Handler& handler);
+bool ParseSSA(const std::string& text, Script& script);
+// Поля, текст и исходный префикс строки события (before не трогается).
+// Недостающие с конца поля остаются как в e, поэтому e должен быть новым.
+void ParseEvent(const std::string& line, const size_t colon, Event& e);
+// Формат строки события без разбора полей и позиция запятой перед текстом.
+// SCR_UNKNOWN, если полей меньше девяти или первое поле не распознано.
+ScriptType SplitEvent(const std::string& line, const size_t colon, size_t& textPos);
+// Время SSA/ASS в миллисекундах
+uint32_t StrToTime(const std::string& str);
+
+// Части вывода SSA/ASS, без перевода строки в конце
+std::string TimeToStr(const uint32_t time);
+// "Имя: значение", как QString("%1: %2").arg(name).arg(value)
+std::string NamedLine(const std::string& name, const std::string& value);
+std::string StyleFields(const Style& s, const ScriptType type);
+// Поля события до текста, с запятой в конце
+std::string EventFields(const Event& e, const ScriptType type);
+// Заголовок секции со строкой Format; для SEC_EXTRA - пустой
+const char* SectionHead(const SectionType section, const ScriptType type);
+const char* ScriptTypeLine(const ScriptType type);
+
+void StripComments(Script& script);
+// Оставляет строки заголовка, нужные для отображения
+void StripInfo(Script& script);
+// Шрифты, графика и неизвестные секции
+void StripAttachments(Script& script);
+
+// Без BOM
+std::string Generate(const Script& script, const ScriptType type);
+}
+
+#endif // LITESCRIPT_H
@@ -17,11 +17,13 @@
  */
 
 #include "cleaner.h"
+#include "trace.h"
 #include <QCoreApplication>
 #include <QCommandLineParser>
 #include <QFileInfo>
 #include <QDir>
 #include <QTimer>
+#include <QCryptographicHash>
 
 int main(int argc, char *argv[])
 {
@@ -31,16 +33,56 @@ int main(int argc, char *argv[])
     app.setOrganizationName("Unlimited Web Works");
 
     QCommandLineParser parser;
-    parser.setApplicationDescription("This program strips fonts, graphics and other useless information from SSA/ASS files.");
+    parser.setApplicationDescription("This program strips fonts, graphics and other useless information from SSA/ASS files and converts between SSA, ASS and SRT.");
     parser.addHelpOption();
     parser.addVersionOption();
     parser.addPositionalArgument("input", "Input subtitle file.");
     parser.addPositionalArgument("output", "Output subtitle file.");
+    const QCommandLineOption outputs({"o", "output"}, "Additional output, format is taken from prefix (ass, ssa, srt) or file extension. Can be repeated.", "[format:]file");
+    parser.addOption(outputs);
 
     const QCommandLineOption stripComments({"c", "strip-comments"}, "Strip comments.");
     const QCommandLineOption stripStyleInfo({"i", "strip-info"}, "Strip useless lines from info section.");
+    const QCommandLineOption stripTags({"t", "strip-tag"}, "Strip override tag from events (e.g. blur, fad or p for drawings). Can be repeated or comma-separated.", "tag");
+    const QCommandLineOption infoRules("info-rules", "Load info section and unknown section rules from file (implies --strip-info).", "file");
     parser.addOption(stripComments);
     parser.addOption(stripStyleInfo);
+    const QCommandLineOption showStats("stats", "Print statistics to stderr.");
+    parser.addOption(infoRules);
+    parser.addOption(showStats);
+    const QCommandLineOption simplifyDrawings("simplify-drawings", "Simplify vector drawings within given tolerance in script pixels.", "pixels");
+    parser.addOption(stripTags);
+    const QCommandLineOption dropStyle("drop-style", "Drop events with matching style (wildcards allowed).", "style");
+    const QCommandLineOption keepStyle("keep-style", "Keep only events with matching style (wildcards allowed).", "style");
+    const QCommandLineOption dropActor("drop-actor", "Drop events with matching actor (wildcards allowed).", "actor");
+    const QCommandLineOption dropLayer("drop-layer", "Drop events on given layers (e.g. 0,5-9).", "layers");
+    const QCommandLineOption dropEffect("drop-effect", "Drop events with matching effect (wildcards allowed).", "effect");
+    const QCommandLineOption extractFonts("extract-fonts", "Extract embedded fonts to directory, named by content hash.", "dir");
+    parser.addOption(simplifyDrawings);
+    parser.addOption(extractFonts);
+    parser.addOption(dropStyle);
+    parser.addOption(keepStyle);
+    parser.addOption(dropActor);
+    parser.addOption(dropLayer);
+    parser.addOption(dropEffect);
+    const QCommandLineOption range("range", "Keep only events overlapping time window (e.g. 0:01:00.00-0:02:30.00).", "start-end");
+    const QCommandLineOption rebase("rebase", "Shift kept events so that --range window starts at zero.");
+    parser.addOption(range);
+    parser.addOption(rebase);
+    const QCommandLineOption sortEvents("sort", "Sort events by start time and layer (stable).");
+    parser.addOption(sortEvents);
+    const QCommandLineOption shiftTimes("shift", "Shift all event times by given milliseconds (may be negative).", "ms");
+    const QCommandLineOption scaleTimes("scale", "Convert times between frame rates (e.g. 25:23.976 or 25:24000/1001).", "from:to");
+    parser.addOption(shiftTimes);
+    parser.addOption(scaleTimes);
+    const QCommandLineOption snapTimecodes("snap-timecodes", "Snap event times to frame boundaries from timecodes v2 file or constant frame rate.", "file|fps");
+    parser.addOption(snapTimecodes);
+    const QCommandLineOption trace("trace", "Write Chrome trace JSON (viewable in Perfetto) with timings of every stage.", "file");
+    parser.addOption(trace);
+    const QCommandLineOption incremental("incremental", "Re-clean only changed event blocks, using an index stored next to the output (single SSA/ASS output).");
+    parser.addOption(incremental);
+    const QCommandLineOption verify("verify", "With --incremental, also clean the whole file and fail if the result differs.");
+    parser.addOption(verify);
 
     parser.process(app);
     const QStringList args = parser.positionalArguments();
@@ -51,26 +93,163 @@ int main(int argc, char *argv[])
         ::exit(EXIT_FAILURE);
     }
     const QString inputFile = args.at(0);
-    QString outputFile;
+    QList<Cleaner::Output> outputFiles;
 
     if (args.length() >= 2)
     {
-        outputFile = args.at(1);
+        outputFiles.append({args.at(1), Script::SCR_UNKNOWN});
     }
-    else
+
+    for (const QString& value : parser.values(outputs))
+    {
+        // Префикс формата; если это не формат (например, "C:\"), всё значение - путь
+        const int pos = value.indexOf(':');
+        const Script::ScriptType type = pos > 0 ? Script::FormatFromSuffix(value.left(pos)) : Script::SCR_UNKNOWN;
+        outputFiles.append({Script::SCR_UNKNOWN != type ? value.mid(pos + 1) : value, type});
+    }
+
+    if (outputFiles.isEmpty())
     {
         const QFileInfo fileInfo(inputFile);
         QStringList fileName = {fileInfo.completeBaseName(), "clean", fileInfo.suffix()};
         fileName.removeAll(""); // На случай пустого суффикса
-        outputFile = fileInfo.dir().filePath(fileName.join('.'));
+        outputFiles.append({fileInfo.dir().filePath(fileName.join('.')), Script::SCR_UNKNOWN});
+    }
+
+    Engine::Options flags;
+    if ( parser.isSet(stripComments) )  flags |= Engine::StripComments;
+    if ( parser.isSet(stripStyleInfo) || parser.isSet(infoRules) ) flags |= Engine::StripStyleInfo;
+    if ( parser.isSet(showStats) )      flags |= Engine::ShowStats;
+    if ( parser.isSet(sortEvents) )     flags |= Engine::SortEvents;
+
+    HeaderPolicy headerPolicy;
+    if ( parser.isSet(infoRules) )
+    {
+        QString error;
+        if ( !headerPolicy.load(parser.value(infoRules), &error) )
+        {
+            fprintf(stderr, "%s\n", qPrintable(error));
+            ::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Повторяющиеся опции, каждая может содержать список через запятую
+    auto listValues = [&parser](const QCommandLineOption& option) {
+        QStringList result;
+        for (const QString& value : parser.values(option))
+        {
+            result.append( value.split(',', QString::SkipEmptyParts) );
+        }
+        return result;
+    };
+
+    EventFilter eventFilter;
+    eventFilter.addDropStyles( listValues(dropStyle) );
+    eventFilter.addKeepStyles( listValues(keepStyle) );
+    eventFilter.addDropActors( listValues(dropActor) );
+    eventFilter.addDropEffects( listValues(dropEffect) );
+    for (const QString& value : parser.values(dropLayer))
+    {
+        if ( !eventFilter.addDropLayers(value) )
+        {
+            fprintf(stderr, "%s\n", qPrintable(QString("Invalid layer list \"%1\".").arg(value)));
+            ::exit(EXIT_FAILURE);
+        }
+    }
+
+    Engine engine(flags);
+    engine.setStripTags( listValues(stripTags) );
+    engine.setEventFilter(eventFilter);
+    engine.setHeaderPolicy(headerPolicy);
+    engine.setFontDir( parser.value(extractFonts) );
+
+    if ( parser.isSet(simplifyDrawings) )
+    {
+        bool ok;
+        const double tolerance = parser.value(simplifyDrawings).toDouble(&ok);
+        if (!ok || tolerance < 0.0)
+        {
+            fprintf(stderr, "%s\n", qPrintable("Drawing tolerance must be a non-negative number."));
+            ::exit(EXIT_FAILURE);
+        }
+        engine.setDrawingTolerance(tolerance);
+    }
+
+    if ( parser.isSet(range) )
+    {
+        uint start, end;
+        if ( !TimeIndex::ParseRange(parser.value(range), start, end) )
+        {
+            fprintf(stderr, "%s\n", qPrintable(QString("Invalid time range \"%1\".").arg(parser.value(range))));
+            ::exit(EXIT_FAILURE);
+        }
+        engine.setRange(start, end, parser.isSet(rebase));
+    }
+
+    Timing::Retime retime;
+    if ( parser.isSet(scaleTimes) && !Timing::ParseScale(parser.value(scaleTimes), retime) )
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("Invalid frame rate conversion \"%1\".").arg(parser.value(scaleTimes))));
+        ::exit(EXIT_FAILURE);
+    }
+    if ( parser.isSet(shiftTimes) )
+    {
+        bool ok;
+        retime.shift = parser.value(shiftTimes).toLongLong(&ok);
+        if (!ok)
+        {
+            fprintf(stderr, "%s\n", qPrintable("Time shift must be an integer number of milliseconds."));
+            ::exit(EXIT_FAILURE);
+        }
+    }
+    engine.setRetime(retime);
+
+    if ( parser.isSet(snapTimecodes) )
+    {
+        Timing::FrameGrid frameGrid;
+        QString error;
+        if ( !frameGrid.load(parser.value(snapTimecodes), &error) )
+        {
+            fprintf(stderr, "%s\n", qPrintable(error));
+            ::exit(EXIT_FAILURE);
+        }
+        engine.setFrameGrid(frameGrid);
+    }
+
+    Cleaner cleaner(&app, inputFile, outputFiles, engine);
+
+    if ( parser.isSet(incremental) )
+    {
+        // Отпечаток параметров: версия, опции и файлы, на которые они ссылаются
+        QCryptographicHash key(QCryptographicHash::Sha1);
+        key.addData( app.applicationVersion().toUtf8() );
+        key.addData( qVersion() );
+        QStringList names = parser.optionNames();
+        names.removeDuplicates();
+        names.removeAll("verify"); // Проверка не меняет вывод
+        for (const QString& name : qAsConst(names))
+        {
+            key.addData( QString("\x1E%1=%2").arg(name, parser.values(name).join('\x1F')).toUtf8() );
+        }
+        for (const QString& fileName : {parser.value(infoRules), parser.value(snapTimecodes)})
+        {
+            QFile file(fileName);
+            if ( !fileName.isEmpty() && file.open(QFile::ReadOnly) ) key.addData(&file);
+        }
+        cleaner.setIncremental( key.result().toHex(), parser.isSet(verify) );
     }
 
-    Cleaner::Options flags;
-    if ( parser.isSet(stripComments) )  flags |= Cleaner::StripComments;
-    if ( parser.isSet(stripStyleInfo) ) flags |= Cleaner::StripStyleInfo;
+    if ( parser.isSet(trace) ) Trace::Start();
 
-    const Cleaner cleaner(&app, inputFile, outputFile, flags);
     QObject::connect(&cleaner, &Cleaner::finished, &app, &QCoreApplication::quit);
     QTimer::singleShot(0, &cleaner, &Cleaner::run);
-    return app.exec();
+    const int result = app.exec();
+
+    if ( parser.isSet(trace) && !Trace::Write(parser.value(trace)) )
+    {
+        fprintf(stderr, "%s\n", qPrintable(QString("Can't write file \"%1\".").arg(parser.value(trace))));
+        return EXIT_FAILURE;
+    }
+
+    return result;
 }
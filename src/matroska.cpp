@@ -0,0 +1,408 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "matroska.h"
+#include <QIODevice>
+#include <QHash>
+#include <algorithm>
+#include <limits>
+
+namespace Matroska
+{
+namespace
+{
+// Идентификаторы элементов EBML/Matroska (вместе с маркером длины)
+const quint32 idEBML             = 0x1A45DFA3;
+const quint32 idSegment          = 0x18538067;
+const quint32 idInfo             = 0x1549A966;
+const quint32 idTimestampScale   = 0x2AD7B1;
+const quint32 idTracks           = 0x1654AE6B;
+const quint32 idTrackEntry       = 0xAE;
+const quint32 idTrackNumber      = 0xD7;
+const quint32 idCodecID          = 0x86;
+const quint32 idCodecPrivate     = 0x63A2;
+const quint32 idLanguage         = 0x22B59C;
+const quint32 idContentEncodings = 0x6D80;
+const quint32 idCluster          = 0x1F43B675;
+const quint32 idTimestamp        = 0xE7;
+const quint32 idBlockGroup       = 0xA0;
+const quint32 idBlock            = 0xA1;
+const quint32 idSimpleBlock      = 0xA3;
+const quint32 idBlockDuration    = 0x9B;
+
+const quint64 unknownSize = ~Q_UINT64_C(0);
+// Больше в память не читаем: заголовки и строки субтитров намного меньше
+const quint64 maxPayload = 16 * 1024 * 1024;
+const qint64 skipChunk = 64 * 1024;
+
+// Контейнеры, в которые спускаемся. Идентификаторы в Matroska не повторяются
+// на разных уровнях, поэтому границы вложенности можно не отслеживать,
+// а элементы неизвестного размера (потоковая запись) не мешают.
+bool IsMaster(const quint32 id)
+{
+    return idSegment == id || idInfo == id || idTracks == id || idTrackEntry == id || idCluster == id || idBlockGroup == id;
+}
+
+struct Block
+{
+    int     order;      // ReadOrder для SSA/ASS, иначе порядок в файле
+    quint64 start;      // Миллисекунды
+    quint64 end;
+    QByteArray data;
+};
+
+class Reader
+{
+public:
+    explicit Reader(QIODevice& device) :
+        _device(device)
+    {}
+
+    qint64 pos() const
+    {
+        return _device.pos();
+    }
+
+    // Идентификатор с маркером длины, 1-4 байта
+    bool readId(quint32& id)
+    {
+        char c;
+        if ( !_device.getChar(&c) ) return false;
+
+        const quint8 first = static_cast<quint8>(c);
+        const int length = first >= 0x80 ? 1 : first >= 0x40 ? 2 : first >= 0x20 ? 3 : first >= 0x10 ? 4 : 0;
+        if (!length) return false;
+
+        id = first;
+        for (int i = 1; i < length; ++i)
+        {
+            if ( !_device.getChar(&c) ) return false;
+            id = (id << 8) | static_cast<quint8>(c);
+        }
+        return true;
+    }
+
+    // Число переменной длины без маркера, 1-8 байт; все единицы - неизвестный размер
+    bool readVint(quint64& value, int* length = nullptr)
+    {
+        char c;
+        if ( !_device.getChar(&c) ) return false;
+
+        const quint8 first = static_cast<quint8>(c);
+        if (!first) return false;
+        int len = 1;
+        while ( !(first & (0x80 >> (len - 1))) ) ++len;
+
+        value = first & (0xFF >> len);
+        bool allOnes = value == static_cast<quint64>(0xFF >> len);
+        for (int i = 1; i < len; ++i)
+        {
+            if ( !_device.getChar(&c) ) return false;
+            value = (value << 8) | static_cast<quint8>(c);
+            allOnes = allOnes && 0xFF == static_cast<quint8>(c);
+        }
+        if (allOnes) value = unknownSize;
+        if (length) *length = len;
+        return true;
+    }
+
+    bool readUInt(const quint64 size, quint64& value)
+    {
+        if (size > 8) return false;
+        const QByteArray data = _device.read(static_cast<qint64>(size));
+        if (data.size() != static_cast<int>(size)) return false;
+
+        value = 0;
+        for (const char c : data) value = (value << 8) | static_cast<quint8>(c);
+        return true;
+    }
+
+    bool readBytes(const quint64 size, QByteArray& data)
+    {
+        if (size > maxPayload) return false;
+        data = _device.read(static_cast<qint64>(size));
+        return data.size() == static_cast<int>(size);
+    }
+
+    bool skip(const quint64 size)
+    {
+        if (unknownSize == size) return false;
+        if ( !_device.isSequential() ) return _device.seek(_device.pos() + static_cast<qint64>(size));
+
+        for (quint64 left = size; left > 0; )
+        {
+            const qint64 chunk = static_cast<qint64>( std::min<quint64>(left, skipChunk) );
+            if (_device.read(chunk).size() != chunk) return false;
+            left -= static_cast<quint64>(chunk);
+        }
+        return true;
+    }
+
+private:
+    QIODevice& _device;
+};
+
+Script::ScriptType TypeFromCodec(const QByteArray& codec)
+{
+    if ("S_TEXT/ASS" == codec)  return Script::SCR_ASS;
+    if ("S_TEXT/SSA" == codec)  return Script::SCR_SSA;
+    if ("S_TEXT/UTF8" == codec) return Script::SCR_SRT;
+    return Script::SCR_UNKNOWN;
+}
+
+QByteArray TimeToBytes(const quint64 time, const Script::ScriptType type)
+{
+    const uint clamped = static_cast<uint>( std::min<quint64>(time, std::numeric_limits<uint>::max()) );
+    return Script::Line::TimeToStr(clamped, type).toLatin1();
+}
+
+// Блок SSA/ASS: "ReadOrder,Layer,Style,Name,MarginL,MarginR,MarginV,Effect,Text"
+QByteArray BuildSSA(const Track& track, QList<Block>& blocks)
+{
+    std::stable_sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+        return a.order < b.order;
+    });
+
+    QByteArray result = track.codecPrivate;
+    if ( !result.endsWith('\n') ) result.append('\n');
+    if ( !result.contains("[Events]") )
+    {
+        result.append("\n[Events]\n");
+        result.append(Script::SCR_ASS == track.type ? "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+                                                    : "Format: Marked, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n");
+    }
+
+    for (const Block& block : qAsConst(blocks))
+    {
+        const int layerPos = block.data.indexOf(',') + 1;
+        const int tailPos = block.data.indexOf(',', layerPos) + 1;
+        if (!layerPos || !tailPos) continue;
+
+        result.append("Dialogue: ");
+        result.append(block.data.constData() + layerPos, tailPos - layerPos);
+        result.append( TimeToBytes(block.start, track.type) );
+        result.append(',');
+        result.append( TimeToBytes(block.end, track.type) );
+        result.append(',');
+        result.append(block.data.constData() + tailPos, block.data.size() - tailPos);
+        result.append('\n');
+    }
+
+    return result;
+}
+
+QByteArray BuildSRT(QList<Block>& blocks)
+{
+    std::stable_sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+        return a.start < b.start;
+    });
+
+    QByteArray result;
+    for (int i = 0; i < blocks.length(); ++i)
+    {
+        const Block& block = blocks.at(i);
+        result.append( QByteArray::number(i + 1) );
+        result.append('\n');
+        result.append( TimeToBytes(block.start, Script::SCR_SRT) );
+        result.append(" --> ");
+        result.append( TimeToBytes(block.end, Script::SCR_SRT) );
+        result.append('\n');
+        result.append( block.data.trimmed() );
+        result.append("\n\n");
+    }
+
+    return result;
+}
+}
+
+bool IsMatroska(const QByteArray& head)
+{
+    return head.startsWith("\x1A\x45\xDF\xA3");
+}
+
+bool ReadTracks(QIODevice& device, QList<Track>& tracks, QString* error)
+{
+    Reader in(device);
+    quint32 id;
+    quint64 size;
+    if ( !in.readId(id) || idEBML != id || !in.readVint(size) || !in.skip(size) )
+    {
+        if (error) *error = "Not a Matroska file.";
+        return false;
+    }
+
+    QList<Track> all;
+    QList< QList<Block> > blocks;
+    QList<bool> encoded;
+    QHash<quint64, int> byNumber;
+    quint64 timestampScale = 1000000, clusterTimestamp = 0;
+
+    // Block внутри BlockGroup ждёт BlockDuration до конца группы
+    bool pending = false;
+    int pendingTrack = -1;
+    Block pendingBlock;
+    qint64 groupEnd = -1;
+    auto flush = [&]() {
+        if (pending) blocks[pendingTrack].append(pendingBlock);
+        pending = false;
+    };
+
+    int order = 0;
+    bool ok = true;
+    for (qint64 elementStart = in.pos(); in.readId(id); elementStart = in.pos())
+    {
+        if ( !in.readVint(size) )
+        {
+            ok = false;
+            break;
+        }
+        if (groupEnd >= 0 && elementStart >= groupEnd)
+        {
+            flush();
+            groupEnd = -1;
+        }
+
+        if (IsMaster(id))
+        {
+            if (idTrackEntry == id)
+            {
+                all.append(Track{0, Script::SCR_UNKNOWN, QByteArray(), QString(), QByteArray()});
+                blocks.append(QList<Block>());
+                encoded.append(false);
+            }
+            else if (idBlockGroup == id)
+            {
+                flush();
+                groupEnd = unknownSize != size ? in.pos() + static_cast<qint64>(size) : -1;
+            }
+            else if (idCluster == id)
+            {
+                flush();
+                groupEnd = -1;
+            }
+            continue;
+        }
+
+        quint64 value;
+        QByteArray data;
+        if (idTimestampScale == id)
+        {
+            ok = in.readUInt(size, value);
+            if (ok && value) timestampScale = value;
+        }
+        else if (idTimestamp == id)
+        {
+            ok = in.readUInt(size, clusterTimestamp);
+        }
+        else if (idTrackNumber == id && !all.isEmpty())
+        {
+            ok = in.readUInt(size, all.last().number);
+            byNumber.insert(all.last().number, all.length() - 1);
+        }
+        else if (idCodecID == id && !all.isEmpty())
+        {
+            ok = in.readBytes(size, data);
+            all.last().type = TypeFromCodec(data);
+        }
+        else if (idCodecPrivate == id && !all.isEmpty() && Script::SCR_UNKNOWN != all.last().type)
+        {
+            ok = in.readBytes(size, all.last().codecPrivate);
+        }
+        else if (idLanguage == id && !all.isEmpty())
+        {
+            ok = in.readBytes(size, data);
+            all.last().language = QString::fromLatin1(data);
+        }
+        else if (idContentEncodings == id && !all.isEmpty())
+        {
+            // Сжатые или зашифрованные блоки не поддерживаются
+            encoded.last() = true;
+            ok = in.skip(size);
+        }
+        else if (idBlockDuration == id)
+        {
+            ok = in.readUInt(size, value);
+            if (ok && pending) pendingBlock.end = pendingBlock.start + value * timestampScale / 1000000;
+        }
+        else if (idSimpleBlock == id || idBlock == id)
+        {
+            // Заголовок: номер дорожки, 16-битное смещение времени, флаги
+            quint64 number;
+            int numberLength;
+            if ( unknownSize == size || !in.readVint(number, &numberLength) || !in.readBytes(3, data) )
+            {
+                ok = false;
+                break;
+            }
+            const quint64 payload = size - static_cast<quint64>(numberLength) - 3;
+            const int track = byNumber.value(number, -1);
+            const bool laced = 0 != (static_cast<quint8>(data.at(2)) & 0x06);
+            if (size < static_cast<quint64>(numberLength) + 3 || -1 == track || Script::SCR_UNKNOWN == all.at(track).type || encoded.at(track) || laced)
+            {
+                ok = size >= static_cast<quint64>(numberLength) + 3 && in.skip(payload);
+            }
+            else
+            {
+                flush();
+
+                const qint16 relative = static_cast<qint16>( (static_cast<quint8>(data.at(0)) << 8) | static_cast<quint8>(data.at(1)) );
+                const qint64 timestamp = std::max(static_cast<qint64>(clusterTimestamp) + relative, Q_INT64_C(0));
+                pendingBlock.start = static_cast<quint64>(timestamp) * timestampScale / 1000000;
+                pendingBlock.end = pendingBlock.start;
+                pendingBlock.order = order++;
+                ok = in.readBytes(payload, pendingBlock.data);
+
+                // ReadOrder - первое поле блока SSA/ASS
+                if (ok && Script::SCR_SRT != all.at(track).type)
+                {
+                    pendingBlock.order = pendingBlock.data.left( pendingBlock.data.indexOf(',') ).toInt();
+                }
+
+                pending = true;
+                pendingTrack = track;
+                if (idSimpleBlock == id) flush();
+            }
+        }
+        else
+        {
+            ok = in.skip(size);
+        }
+
+        if (!ok) break;
+    }
+    flush();
+
+    if (!ok)
+    {
+        if (error) *error = "Broken Matroska file.";
+        return false;
+    }
+
+    tracks.clear();
+    for (int i = 0; i < all.length(); ++i)
+    {
+        Track& track = all[i];
+        if (Script::SCR_UNKNOWN == track.type || encoded.at(i)) continue;
+
+        track.script = Script::SCR_SRT == track.type ? BuildSRT(blocks[i]) : BuildSSA(track, blocks[i]);
+        tracks.append(track);
+    }
+
+    return true;
+}
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATROSKA_H
+#define MATROSKA_H
+
+#include "script.h"
+#include <QByteArray>
+
+class QIODevice;
+
+// Потоковое чтение текстовых субтитров из Matroska (.mkv, .mks).
+// Файл читается один раз от начала до конца; всё, кроме заголовков дорожек
+// и блоков нужных дорожек (видео, звук, вложения, индексы), пропускается seek'ом.
+namespace Matroska
+{
+struct Track
+{
+    quint64             number;
+    Script::ScriptType  type;           // SCR_ASS, SCR_SSA или SCR_SRT (S_TEXT/UTF8)
+    QByteArray          codecPrivate;   // Для SSA/ASS - заголовок скрипта до событий
+    QString             language;
+
+    // Текст дорожки в исходном формате, готовый для Engine::parse
+    QByteArray script;
+};
+
+bool IsMatroska(const QByteArray& head);
+bool ReadTracks(QIODevice& device, QList<Track>& tracks, QString* error = nullptr);
+}
+
+#endif // MATROSKA_H
@@ -0,0 +1,230 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pass.h"
+
+namespace
+{
+// Оставляет строки, для которых remove() вернул false; удалённые освобождаются
+template <class T, class Remove>
+void Compact(QList<T*>& content, Remove remove)
+{
+    int kept = 0;
+    for (int i = 0, len = content.length(); i < len; ++i)
+    {
+        T* const line = content.at(i);
+        if ( remove(line) )
+        {
+            delete line;
+        }
+        else
+        {
+            content[kept++] = line;
+        }
+    }
+    content.erase(content.begin() + kept, content.end());
+}
+}
+
+//
+// Проход
+//
+Pass::Pass(const char* name, const Targets targets) :
+    _name(name),
+    _targets(targets)
+{}
+
+Pass::~Pass()
+{}
+
+const char* Pass::name() const
+{
+    return _name;
+}
+
+Pass::Targets Pass::targets() const
+{
+    return _targets;
+}
+
+void Pass::begin(Script::Script& script)
+{
+    Q_UNUSED(script);
+}
+
+bool Pass::header(Script::Line::Named* line)
+{
+    Q_UNUSED(line);
+    return false;
+}
+
+bool Pass::style(Script::Line::Style* line)
+{
+    Q_UNUSED(line);
+    return false;
+}
+
+bool Pass::event(Script::Line::Event* line)
+{
+    Q_UNUSED(line);
+    return false;
+}
+
+bool Pass::extra(const Script::Section<Script::Line::Base>* section)
+{
+    Q_UNUSED(section);
+    return false;
+}
+
+bool Pass::text(QString& text)
+{
+    Q_UNUSED(text);
+    return false;
+}
+
+void Pass::end(Script::Script& script)
+{
+    Q_UNUSED(script);
+}
+
+//
+// Список проходов
+//
+PassList::PassList()
+{}
+
+PassList::~PassList()
+{
+    qDeleteAll(_passes);
+}
+
+void PassList::add(Pass* pass)
+{
+    _passes.append(pass);
+}
+
+bool PassList::isEmpty() const
+{
+    return _passes.isEmpty();
+}
+
+int PassList::length() const
+{
+    return _passes.length();
+}
+
+const Pass* PassList::at(const int i) const
+{
+    return _passes.at(i);
+}
+
+QVector<int> PassList::run(Script::Script& script) const
+{
+    QVector<int> removed(_passes.length(), 0);
+
+    // Номера проходов для каждой секции, чтобы в обходе не проверять флаги
+    QVector<int> header, styles, events, extra;
+    for (int i = 0; i < _passes.length(); ++i)
+    {
+        const Pass::Targets targets = _passes.at(i)->targets();
+        if (targets & Pass::HeaderLines) header.append(i);
+        if (targets & Pass::StyleLines) styles.append(i);
+        if (targets & (Pass::EventLines | Pass::EventText)) events.append(i);
+        if (targets & Pass::ExtraSections) extra.append(i);
+
+        _passes.at(i)->begin(script);
+    }
+
+    if (!header.isEmpty())
+    {
+        Compact(script.header.content, [&](Script::Line::Named* const line) {
+            for (const int i : header)
+            {
+                if ( _passes.at(i)->header(line) )
+                {
+                    ++removed[i];
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    if (!styles.isEmpty())
+    {
+        Compact(script.styles.content, [&](Script::Line::Style* const line) {
+            for (const int i : styles)
+            {
+                if ( _passes.at(i)->style(line) )
+                {
+                    ++removed[i];
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    if (!events.isEmpty())
+    {
+        Compact(script.events.content, [&](Script::Line::Event* const line) {
+            // Текст разбирается при первом обращении и собирается обратно один раз
+            QString text;
+            bool decoded = false, changed = false;
+            for (const int i : events)
+            {
+                Pass* const pass = _passes.at(i);
+                if ( (pass->targets() & Pass::EventLines) && pass->event(line) )
+                {
+                    ++removed[i];
+                    return true;
+                }
+                if (pass->targets() & Pass::EventText)
+                {
+                    if (!decoded)
+                    {
+                        text = line->text();
+                        decoded = true;
+                    }
+                    if ( pass->text(text) ) changed = true;
+                }
+            }
+            if (changed) line->setText(text);
+            return false;
+        });
+    }
+
+    if (!extra.isEmpty())
+    {
+        Compact(script.extra, [&](Script::Section<Script::Line::Base>* const section) {
+            for (const int i : extra)
+            {
+                if ( _passes.at(i)->extra(section) )
+                {
+                    ++removed[i];
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    for (Pass* const pass : _passes) pass->end(script);
+
+    return removed;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PASS_H
+#define PASS_H
+
+#include "script.h"
+#include <QVector>
+
+// Построчное преобразование скрипта. Проход объявляет, какие секции и поля
+// он трогает; PassList сливает все проходы в один обход каждой секции.
+class Pass
+{
+public:
+    enum Target {
+        HeaderLines   = 1 << 0,
+        StyleLines    = 1 << 1,
+        EventLines    = 1 << 2,
+        EventText     = 1 << 3, // Текст события разбирается один раз на все проходы
+        ExtraSections = 1 << 4
+    };
+    Q_DECLARE_FLAGS(Targets, Target)
+
+    // name - строковый литерал, для статистики и трассировки
+    Pass(const char* name, const Targets targets);
+    virtual ~Pass();
+
+    const char* name() const;
+    Targets targets() const;
+
+    // До обхода: подготовка по всему скрипту
+    virtual void begin(Script::Script& script);
+    // true - удалить; следующие проходы удалённую строку не видят
+    virtual bool header(Script::Line::Named* line);
+    virtual bool style(Script::Line::Style* line);
+    virtual bool event(Script::Line::Event* line);
+    virtual bool extra(const Script::Section<Script::Line::Base>* section);
+    // true - текст изменён
+    virtual bool text(QString& text);
+    // После обхода: секции целиком
+    virtual void end(Script::Script& script);
+
+private:
+    const char* _name;
+    const Targets _targets;
+};
+Q_DECLARE_OPERATORS_FOR_FLAGS(Pass::Targets)
+
+// Проходы в порядке добавления; список владеет ими
+class PassList
+{
+public:
+    PassList();
+    ~PassList();
+
+    void add(Pass* pass);
+    bool isEmpty() const;
+    int length() const;
+    const Pass* at(const int i) const;
+
+    // Возвращает, сколько строк (секций) удалил каждый проход
+    QVector<int> run(Script::Script& script) const;
+
+private:
+    QList<Pass*> _passes;
+
+    Q_DISABLE_COPY(PassList)
+};
+
+#endif // PASS_H
@@ -23,10 +23,112 @@
 
 namespace Script
 {
+// Таблица уникальных строк
+StringPool::Id StringPool::intern(const QString& str)
+{
+    const auto it = _index.constFind(str);
+    if (_index.constEnd() != it) return it.value();
+
+    const Id id = _strings.length();
+    _strings.append(str);
+    _usage.append(0);
+    _index.insert(str, id);
+    return id;
+}
+
+StringPool::Id StringPool::find(const QString& str) const
+{
+    return _index.value(str, -1);
+}
+
+const QString& StringPool::at(const Id id) const
+{
+    return _strings.at(id);
+}
+
+int StringPool::count() const
+{
+    return _strings.length();
+}
+
+int StringPool::usage(const Id id) const
+{
+    return _usage.at(id);
+}
+
+// Переименование меняет строку сразу у всех событий.
+// Слить две строки нельзя: имя не должно быть занято.
+bool StringPool::rename(const Id id, const QString& str)
+{
+    if (_strings.at(id) == str) return true;
+    if (_index.contains(str)) return false;
+
+    _index.remove(_strings.at(id));
+    _strings[id] = str;
+    _index.insert(str, id);
+    return true;
+}
+
+void StringPool::ref(const Id id)
+{
+    ++_usage[id];
+}
+
+void StringPool::deref(const Id id)
+{
+    --_usage[id];
+}
+
+QByteArrayList ToUtf8(const QStringList& list)
+{
+    QByteArrayList result;
+    result.reserve(list.length());
+    for (const QString& str : list) result.append( str.toUtf8() );
+    return result;
+}
+
+QStringList FromUtf8(const QByteArrayList& list)
+{
+    QStringList result;
+    result.reserve(list.length());
+    for (const QByteArray& str : list) result.append( QString::fromUtf8(str) );
+    return result;
+}
+
+// SRT в общем ядре нет, поэтому сюда не попадает
+Lite::ScriptType ToLite(const ScriptType type)
+{
+    return SCR_SSA == type ? Lite::SCR_SSA : Lite::SCR_ASS;
+}
+
+Lite::SectionType ToLite(const SectionType section)
+{
+    switch (section)
+    {
+    case SEC_HEADER:   return Lite::SEC_HEADER;
+    case SEC_STYLES:   return Lite::SEC_STYLES;
+    case SEC_EVENTS:   return Lite::SEC_EVENTS;
+    case SEC_FONTS:    return Lite::SEC_FONTS;
+    case SEC_GRAPHICS: return Lite::SEC_GRAPHICS;
+    default:           return Lite::SEC_EXTRA;
+    }
+}
+
+static QByteArrayList ToByteArrays(const Lite::Lines& lines)
+{
+    QByteArrayList result;
+    result.reserve( static_cast<int>(lines.size()) );
+    for (const std::string& line : lines) result.append( QByteArray(line.data(), static_cast<int>(line.size())) );
+    return result;
+}
+
 namespace Line
 {
-uint StrToTime(const QString& str, const ScriptType type)
+template <ScriptType T>
+uint StrToTime(const QString& str)
 {
+    if (SCR_ASS == T || SCR_SSA == T) return Lite::StrToTime( str.toStdString() );
+
     // В этой функции мы пытаемся получить хоть какое-то время из строки.
     // Считаем, что чисел может недоставать только с конца (миллисекунды и далее).
     uint hour = 0,
@@ -51,8 +153,7 @@ uint StrToTime(const QString& str, const ScriptType type)
 
     if (!list.isEmpty())
     {
-        if (SCR_ASS == type || SCR_SSA == type) list = list.first().split('.');
-        else list = list.first().split(',');
+        list = list.first().split(',');
 
         // Секунды
         if (!list.isEmpty())
@@ -65,31 +166,50 @@ uint StrToTime(const QString& str, const ScriptType type)
         if (!list.isEmpty())
         {
             msec = list.first().trimmed().toUInt();
-            if (SCR_ASS == type || SCR_SSA == type) msec *= 10u;
         }
     }
 
     return ((hour * 60u + min) * 60u + sec) * 1000u + msec;
 }
 
-QString TimeToStr(const uint time, const ScriptType type)
+template <ScriptType T>
+QString TimeToStr(const uint time)
 {
+    if (SCR_ASS == T || SCR_SSA == T) return QString::fromStdString( Lite::TimeToStr(time) );
+
     const uint hour = time / 3600000u,
                min  = time / 60000u % 60u,
                sec  = time / 1000u  % 60u,
                msec = time % 1000u;
 
-    QString ret;
-    if (SCR_ASS == type || SCR_SSA == type)
+    return QString("%1:%2:%3,%4").arg(hour, 2, 10, QChar('0')).arg(min, 2, 10, QChar('0')).arg(sec, 2, 10, QChar('0')).arg(msec, 3, 10, QChar('0'));
+}
+
+template uint StrToTime<SCR_SSA>(const QString& str);
+template uint StrToTime<SCR_ASS>(const QString& str);
+template uint StrToTime<SCR_SRT>(const QString& str);
+template QString TimeToStr<SCR_SSA>(const uint time);
+template QString TimeToStr<SCR_ASS>(const uint time);
+template QString TimeToStr<SCR_SRT>(const uint time);
+
+uint StrToTime(const QString& str, const ScriptType type)
+{
+    switch (type)
     {
-        ret = QString("%1:%2:%3.%4").arg(hour).arg(min, 2, 10, QChar('0')).arg(sec, 2, 10, QChar('0')).arg(msec / 10u, 2, 10, QChar('0'));
+    case SCR_SSA: return StrToTime<SCR_SSA>(str);
+    case SCR_ASS: return StrToTime<SCR_ASS>(str);
+    default:      return StrToTime<SCR_SRT>(str);
     }
-    else
+}
+
+QString TimeToStr(const uint time, const ScriptType type)
+{
+    switch (type)
     {
-        ret = QString("%1:%2:%3,%4").arg(hour, 2, 10, QChar('0')).arg(min, 2, 10, QChar('0')).arg(sec, 2, 10, QChar('0')).arg(msec, 3, 10, QChar('0'));
+    case SCR_SSA: return TimeToStr<SCR_SSA>(time);
+    case SCR_ASS: return TimeToStr<SCR_ASS>(time);
+    default:      return TimeToStr<SCR_SRT>(time);
     }
-
-    return ret;
 }
 
 // Базовая строка
@@ -97,13 +217,22 @@ Base::Base()
 {}
 
 Base::Base(const QString& value) :
+    _value(value.toUtf8())
+{}
+
+Base::Base(const QByteArray& value) :
     _value(value)
 {}
 
+QString Base::value() const
+{
+    return QString::fromUtf8(_value);
+}
+
 QString Base::generate(const ScriptType type) const
 {
     Q_UNUSED(type);
-    return _value;
+    return QString::fromUtf8(_value);
 }
 
 // Простейшая строка с двоеточием
@@ -112,6 +241,11 @@ Named::Named(const QString& name) :
 {}
 
 Named::Named(const QString& name, const QStringList& before) :
+    _name(name),
+    _before(ToUtf8(before))
+{}
+
+Named::Named(const QString& name, const QByteArrayList& before) :
     _name(name),
     _before(before)
 {}
@@ -126,28 +260,66 @@ QString Named::name() const
     return _name;
 }
 
-QString Named::generate(const ScriptType type, const QString& value) const
+QStringList Named::before() const
 {
-    QString result;
+    return FromUtf8(_before);
+}
 
-    if (SCR_ASS == type || SCR_SSA == type)
+QString Named::text() const
+{
+    return QString::fromUtf8(_text);
+}
+
+void Named::setText(const QString& text)
+{
+    _text = text.toUtf8();
+}
+
+const QByteArray& Named::textUtf8() const
+{
+    return _text;
+}
+
+void Named::setTextUtf8(const QByteArray& text)
+{
+    _text = text;
+}
+
+QByteArray Named::generateBefore() const
+{
+    QByteArray result;
+
+    if (_before.length())
     {
-        if (_before.length())
-        {
-            result.append( _before.join("\n") );
-            result.append("\n");
-        }
-        result.append( QString("%1: %2").arg(_name).arg(value) );
+        result = _before.join('\n');
+        result.append('\n');
     }
 
     return result;
 }
 
+// Имя с "%" подставляется по правилам QString::arg(), как в общем ядре
+QByteArray Named::generateLine(const QByteArray& value) const
+{
+    QByteArray result = this->generateBefore();
+    if ( _name.contains('%') )
+    {
+        result.append( QByteArray::fromStdString(Lite::NamedLine( _name.toStdString(), value.toStdString() )) );
+    }
+    else
+    {
+        result.append( _name.toUtf8() );
+        result.append(": ");
+        result.append(value);
+    }
+    return result;
+}
+
 QString Named::generate(const ScriptType type) const
 {
     QString result;
 
-    if (SCR_ASS == type || SCR_SSA == type) result = this->generate(type, text);
+    if (SCR_ASS == type || SCR_SSA == type) result = QString::fromUtf8( this->generateLine(_text) );
 
     return result;
 }
@@ -165,6 +337,33 @@ Style::Style(const QStringList& before) :
     this->init();
 }
 
+Style::Style(const Lite::Style& other) :
+    Named("Style", ToByteArrays(other.before)),
+    styleName(QString::fromStdString(other.styleName)),
+    fontName(QString::fromStdString(other.fontName)),
+    fontSize(other.fontSize),
+    primaryColour(other.primaryColour),
+    secondaryColour(other.secondaryColour),
+    outlineColour(other.outlineColour),
+    backColour(other.backColour),
+    bold(other.bold),
+    italic(other.italic),
+    underline(other.underline),
+    strikeOut(other.strikeOut),
+    scaleX(other.scaleX),
+    scaleY(other.scaleY),
+    spacing(other.spacing),
+    angle(other.angle),
+    borderStyle(other.borderStyle),
+    outline(other.outline),
+    shadow(other.shadow),
+    alignment(other.alignment),
+    marginL(other.marginL),
+    marginR(other.marginR),
+    marginV(other.marginV),
+    encoding(other.encoding)
+{}
+
 void Style::init()
 {
     styleName       = defaultStyle;
@@ -192,137 +391,441 @@ void Style::init()
     encoding        = 1;
 }
 
-QString Style::generate(const ScriptType type) const
+template <ScriptType T>
+QString Style::generateAs() const
 {
-    QString result;
+    return SCR_ASS == T || SCR_SSA == T ? QString::fromUtf8( this->generateUtf8<T>() ) : QString();
+}
 
-    if (SCR_ASS == type || SCR_SSA == type)
+template <ScriptType T>
+QByteArray Style::generateUtf8() const
+{
+    QByteArray result;
+
+    if (SCR_ASS == T || SCR_SSA == T)
     {
-        QStringList list;
+        // Комментарии выводит generateLine()
+        Lite::Style s;
+        s.styleName       = styleName.toStdString();
+        s.fontName        = fontName.toStdString();
+        s.fontSize        = fontSize;
+        s.primaryColour   = primaryColour;
+        s.secondaryColour = secondaryColour;
+        s.outlineColour   = outlineColour;
+        s.backColour      = backColour;
+        s.bold            = bold;
+        s.italic          = italic;
+        s.underline       = underline;
+        s.strikeOut       = strikeOut;
+        s.scaleX          = scaleX;
+        s.scaleY          = scaleY;
+        s.spacing         = spacing;
+        s.angle           = angle;
+        s.borderStyle     = borderStyle;
+        s.outline         = outline;
+        s.shadow          = shadow;
+        s.alignment       = alignment;
+        s.marginL         = marginL;
+        s.marginR         = marginR;
+        s.marginV         = marginV;
+        s.encoding        = encoding;
+
+        result = this->generateLine( QByteArray::fromStdString(Lite::StyleFields( s, ToLite(T) )) );
+    }
 
-        list.append(styleName);
-        list.append(fontName);
-        list.append( QString::number(fontSize, 'g', 10) );
+    return result;
+}
 
-        if (SCR_ASS == type)
-        {
-            list.append( QString("&H%1").arg(primaryColour,   8, 16, QChar('0')).toUpper() );
-            list.append( QString("&H%1").arg(secondaryColour, 8, 16, QChar('0')).toUpper() );
-            list.append( QString("&H%1").arg(outlineColour,   8, 16, QChar('0')).toUpper() );
-            list.append( QString("&H%1").arg(backColour,      8, 16, QChar('0')).toUpper() );
-        }
-        else
-        {
-            list.append( QString::number( static_cast<qint32>(primaryColour) ) );
-            list.append( QString::number( static_cast<qint32>(secondaryColour) ) );
-            list.append( QString::number( static_cast<qint32>(outlineColour) ) );
-            list.append( QString::number( static_cast<qint32>(backColour) ) );
-        }
+template QString Style::generateAs<SCR_SSA>() const;
+template QString Style::generateAs<SCR_ASS>() const;
+template QString Style::generateAs<SCR_SRT>() const;
+template QByteArray Style::generateUtf8<SCR_SSA>() const;
+template QByteArray Style::generateUtf8<SCR_ASS>() const;
+template QByteArray Style::generateUtf8<SCR_SRT>() const;
 
-        list.append( bold   ? "-1" : "0" );
-        list.append( italic ? "-1" : "0" );
+QString Style::generate(const ScriptType type) const
+{
+    switch (type)
+    {
+    case SCR_SSA: return this->generateAs<SCR_SSA>();
+    case SCR_ASS: return this->generateAs<SCR_ASS>();
+    default:      return QString();
+    }
+}
 
-        if (SCR_ASS == type)
-        {
-            list.append( underline ? "-1" : "0" );
-            list.append( strikeOut ? "-1" : "0" );
-            list.append( QString::number(scaleX,  'g', 10) );
-            list.append( QString::number(scaleY,  'g', 10) );
-            list.append( QString::number(spacing, 'g', 10) );
-            list.append( QString::number(angle,   'g', 10) );
-        }
+// Строка события
+Event::Event(EventNames* names) :
+    Named("Dialogue"),
+    _names(names)
+{
+    this->init();
+}
 
-        list.append( QString::number(borderStyle) );
-        list.append( QString::number(outline, 'g', 10) );
-        list.append( QString::number(shadow,  'g', 10) );
+Event::Event(EventNames* names, const QStringList& before) :
+    Named("Dialogue", before),
+    _names(names)
+{
+    this->init();
+}
 
-        if (SCR_SSA == type && alignment > 0 && alignment < AlignmentASS.length())
-        {
-            list.append( QString::number(AlignmentASS.at(alignment)) );
-        }
-        else
-        {
-            list.append( QString::number(alignment) );
-        }
+Event::Event(EventNames* names, const QByteArrayList& before) :
+    Named("Dialogue", before),
+    _names(names)
+{
+    this->init();
+}
 
-        list.append( QString::number(marginL) );
-        list.append( QString::number(marginR) );
-        list.append( QString::number(marginV) );
+Event::Event(EventNames* names, const QByteArrayList& before, const QByteArray& prefix, const ScriptType type) :
+    Named("Dialogue", before),
+    _names(names),
+    _rawPrefix(prefix),
+    _rawType(type),
+    _parsed(false),
+    _layer(0),
+    _start(0),
+    _end(0),
+    _marginL(0),
+    _marginR(0),
+    _marginV(0),
+    _style(0),
+    _actorName(0),
+    _effect(0)
+{}
 
-        if (SCR_SSA == type)
-        {
-            list.append("0");
-        }
+// Неразобранная копия остаётся неразобранной и не держит ссылок в пуле
+Event::Event(const Event& other) :
+    Named(other),
+    _names(other._names),
+    _rawPrefix(other._rawPrefix),
+    _rawType(other._rawType),
+    _parsed(other._parsed),
+    _layer(other._layer),
+    _start(other._start),
+    _end(other._end),
+    _marginL(other._marginL),
+    _marginR(other._marginR),
+    _marginV(other._marginV),
+    _style(other._style),
+    _actorName(other._actorName),
+    _effect(other._effect)
+{
+    if (!_parsed) return;
+    _names->styles.ref(_style);
+    _names->actors.ref(_actorName);
+    _names->effects.ref(_effect);
+}
 
-        list.append( QString::number(encoding) );
+Event::~Event()
+{
+    if (!_parsed) return;
+    _names->styles.deref(_style);
+    _names->actors.deref(_actorName);
+    _names->effects.deref(_effect);
+}
 
-        result = Named::generate(type, list.join(','));
+Event& Event::operator=(const Event& other)
+{
+    if (this != &other)
+    {
+        other.parse();
+        this->parse();
+
+        Named::operator=(other);
+        _layer   = other._layer;
+        _start   = other._start;
+        _end     = other._end;
+        _marginL = other._marginL;
+        _marginR = other._marginR;
+        _marginV = other._marginV;
+        this->assign(_names->styles,  _style,     other.style());
+        this->assign(_names->actors,  _actorName, other.actorName());
+        this->assign(_names->effects, _effect,    other.effect());
+
+        _rawPrefix = other._rawPrefix;
+        _rawType   = other._rawType;
     }
+    return *this;
+}
 
-    return result;
+void Event::init()
+{
+    _parsed  = true;
+    _layer   = 0;
+    _start   = 0;
+    _end     = 0;
+    _marginL = 0;
+    _marginR = 0;
+    _marginV = 0;
+
+    _style     = _names->styles.intern(defaultStyle);
+    _actorName = _names->actors.intern(QString());
+    _effect    = _names->effects.intern(QString());
+    _names->styles.ref(_style);
+    _names->actors.ref(_actorName);
+    _names->effects.ref(_effect);
+
+    this->clearRaw();
 }
 
-// Строка события
-Event::Event() :
-    Named("Dialogue")
+// Префикс оканчивается запятой перед текстом, так что текст разбирается пустым
+void Event::parse() const
 {
-    this->init();
+    if (_parsed) return;
+
+    const std::string prefix = _rawPrefix.toStdString();
+    Lite::Event e;
+    Lite::ParseEvent(prefix, prefix.find(':'), e);
+
+    _layer   = e.layer;
+    _start   = e.start;
+    _end     = e.end;
+    _marginL = e.marginL;
+    _marginR = e.marginR;
+    _marginV = e.marginV;
+
+    _style     = _names->styles.intern( QString::fromStdString(e.style) );
+    _actorName = _names->actors.intern( QString::fromStdString(e.actorName) );
+    _effect    = _names->effects.intern( QString::fromStdString(e.effect) );
+    _names->styles.ref(_style);
+    _names->actors.ref(_actorName);
+    _names->effects.ref(_effect);
+
+    _parsed = true;
 }
 
-Event::Event(const QStringList& before) :
-    Named("Dialogue", before)
+// Поля должны быть разобраны: после сброса их больше неоткуда взять
+void Event::clearRaw()
 {
-    this->init();
+    _rawPrefix.clear();
+    _rawType = SCR_UNKNOWN;
 }
 
-void Event::init()
+// Исходная строка сбрасывается только при настоящем изменении
+template <typename V>
+void Event::change(V& field, const V value)
 {
-    layer   = 0;
-    start   = 0;
-    end     = 0;
-    style   = defaultStyle;
-    marginL = 0;
-    marginR = 0;
-    marginV = 0;
+    this->parse();
+    if (field == value) return;
+
+    field = value;
+    this->clearRaw();
 }
 
-QString Event::generate(const ScriptType type) const
+uint Event::layer() const
 {
-    QString result;
+    this->parse();
+    return _layer;
+}
 
-    if (SCR_ASS == type || SCR_SSA == type)
-    {
-        QStringList list;
+uint Event::start() const
+{
+    this->parse();
+    return _start;
+}
 
-        if (SCR_SSA == type)
-        {
-            list.append( QString("Marked=%1").arg(layer) );
-        }
-        else
-        {
-            list.append( QString::number(layer) );
-        }
+uint Event::end() const
+{
+    this->parse();
+    return _end;
+}
+
+ushort Event::marginL() const
+{
+    this->parse();
+    return _marginL;
+}
+
+ushort Event::marginR() const
+{
+    this->parse();
+    return _marginR;
+}
+
+ushort Event::marginV() const
+{
+    this->parse();
+    return _marginV;
+}
+
+void Event::setLayer(const uint layer)
+{
+    this->change(_layer, layer);
+}
+
+void Event::setStart(const uint start)
+{
+    this->change(_start, start);
+}
+
+void Event::setEnd(const uint end)
+{
+    this->change(_end, end);
+}
+
+void Event::setMarginL(const ushort marginL)
+{
+    this->change(_marginL, marginL);
+}
+
+void Event::setMarginR(const ushort marginR)
+{
+    this->change(_marginR, marginR);
+}
+
+void Event::setMarginV(const ushort marginV)
+{
+    this->change(_marginV, marginV);
+}
+
+const QByteArray& Event::rawPrefix() const
+{
+    return _rawPrefix;
+}
+
+void Event::setRawPrefix(const QByteArray& prefix)
+{
+    this->parse();
+    this->clearRaw();
+
+    const std::string line = prefix.toStdString();
+    const size_t colon = line.find(':');
+    if (std::string::npos == colon) return;
+
+    size_t textPos;
+    const Lite::ScriptType type = Lite::SplitEvent(line, colon, textPos);
+    if (Lite::SCR_UNKNOWN == type || textPos + 1 != line.size()) return;
+
+    _rawPrefix = prefix;
+    _rawType   = Lite::SCR_SSA == type ? SCR_SSA : SCR_ASS;
+}
+
+void Event::assign(StringPool& pool, StringPool::Id& field, const QString& value)
+{
+    this->parse();
+    this->clearRaw();
+
+    const StringPool::Id id = pool.intern(value);
+    pool.ref(id);
+    pool.deref(field);
+    field = id;
+}
+
+QString Event::style() const
+{
+    this->parse();
+    return _names->styles.at(_style);
+}
+
+QString Event::actorName() const
+{
+    this->parse();
+    return _names->actors.at(_actorName);
+}
 
-        list.append( TimeToStr(start, type) );
-        list.append( TimeToStr(end, type) );
-        list.append(style);
-        list.append(actorName);
-        list.append( QString::number(marginL) );
-        list.append( QString::number(marginR) );
-        list.append( QString::number(marginV) );
-        list.append(effect);
-        list.append(text);
-
-        result = Named::generate(type, list.join(','));
+QString Event::effect() const
+{
+    this->parse();
+    return _names->effects.at(_effect);
+}
+
+StringPool::Id Event::styleId() const
+{
+    this->parse();
+    return _style;
+}
+
+StringPool::Id Event::actorId() const
+{
+    this->parse();
+    return _actorName;
+}
+
+StringPool::Id Event::effectId() const
+{
+    this->parse();
+    return _effect;
+}
+
+void Event::setStyle(const QString& style)
+{
+    this->assign(_names->styles, _style, style);
+}
+
+void Event::setActorName(const QString& actorName)
+{
+    this->assign(_names->actors, _actorName, actorName);
+}
+
+void Event::setEffect(const QString& effect)
+{
+    this->assign(_names->effects, _effect, effect);
+}
+
+template <ScriptType T>
+QString Event::generateAs() const
+{
+    QString result;
+
+    if (SCR_ASS == T || SCR_SSA == T)
+    {
+        result = QString::fromUtf8( this->generateUtf8<T>() );
     }
-    else if (SCR_SRT == type)
+    else if (SCR_SRT == T)
     {
-        result.append( QString("%1 --> %2\n").arg(TimeToStr(start, type)).arg(TimeToStr(end, type)) );
-        result.append( QString(text).replace("\\N", "\n", Qt::CaseInsensitive) );
+        result.append( QString("%1 --> %2\n").arg(TimeToStr<T>( this->start() )).arg(TimeToStr<T>( this->end() )) );
+        result.append( this->text().replace("\\N", "\n", Qt::CaseInsensitive) );
     }
 
     return result;
 }
+
+// Исходные строки не перекодируются и не собираются заново
+template <ScriptType T>
+QByteArray Event::generateUtf8() const
+{
+    if (SCR_ASS != T && SCR_SSA != T) return this->generateAs<T>().toUtf8();
+
+    // Исходная строка цела, пока поля не менялись: копируется без разбора
+    if (T == _rawType)
+    {
+        QByteArray result = this->generateBefore();
+        result.append(_rawPrefix);
+        result.append(_text);
+        return result;
+    }
+
+    this->parse();
+    Lite::Event e;
+    e.layer     = _layer;
+    e.start     = _start;
+    e.end       = _end;
+    e.style     = _names->styles.at(_style).toStdString();
+    e.actorName = _names->actors.at(_actorName).toStdString();
+    e.marginL   = _marginL;
+    e.marginR   = _marginR;
+    e.marginV   = _marginV;
+    e.effect    = _names->effects.at(_effect).toStdString();
+
+    return this->generateLine( QByteArray::fromStdString(Lite::EventFields( e, ToLite(T) )) + _text );
+}
+
+template QString Event::generateAs<SCR_SSA>() const;
+template QString Event::generateAs<SCR_ASS>() const;
+template QString Event::generateAs<SCR_SRT>() const;
+template QByteArray Event::generateUtf8<SCR_SSA>() const;
+template QByteArray Event::generateUtf8<SCR_ASS>() const;
+template QByteArray Event::generateUtf8<SCR_SRT>() const;
+
+QString Event::generate(const ScriptType type) const
+{
+    switch (type)
+    {
+    case SCR_SSA: return this->generateAs<SCR_SSA>();
+    case SCR_ASS: return this->generateAs<SCR_ASS>();
+    case SCR_SRT: return this->generateAs<SCR_SRT>();
+    default:      return QString();
+    }
+}
 }
 
 // Скрипт
@@ -334,6 +837,11 @@ Script::Script() :
     graphics(SEC_GRAPHICS)
 {}
 
+Script::~Script()
+{
+    qDeleteAll(extra);
+}
+
 void Script::clearBefore()
 {
     _before.clear();
@@ -351,61 +859,150 @@ void Script::clear()
     events.clear();
     fonts.clear();
     graphics.clear();
+    qDeleteAll(extra);
+    extra.clear();
     clearBefore();
     clearAfter();
 }
 
 void Script::appendBefore(const QStringList& before)
 {
-    _before.append(before);
+    _before.append( ToUtf8(before) );
 }
 
 void Script::appendAfter(const QStringList& after)
+{
+    _after.append( ToUtf8(after) );
+}
+
+void Script::appendBefore(const QByteArrayList& before)
+{
+    _before.append(before);
+}
+
+void Script::appendAfter(const QByteArrayList& after)
 {
     _after.append(after);
 }
 
+void Script::parseEvents()
+{
+    for (const Line::Event* const e : events.content) e->parse();
+}
+
+QStringList Script::before() const
+{
+    return FromUtf8(_before);
+}
+
+QStringList Script::after() const
+{
+    return FromUtf8(_after);
+}
+
+// Строки событий SSA/ASS; формат выбран один раз на весь список
+template <ScriptType T>
+static void AppendEvents(QByteArray& result, const QList<Line::Event*>& events)
+{
+    for (const Line::Event* const e : events)
+    {
+        result.append( e->generateUtf8<T>() );
+        result.append('\n');
+    }
+}
+
 QString Script::generate(const ScriptType type) const
 {
     QString result;
 
+    if (SCR_ASS == type || SCR_SSA == type)
+    {
+        QByteArray text = this->generateHead(type);
+        if (SCR_ASS == type) AppendEvents<SCR_ASS>(text, events.content);
+        else                 AppendEvents<SCR_SSA>(text, events.content);
+        text.append( this->generateTail(type) );
+        result = QString::fromUtf8(text);
+    }
+    else if (SCR_SRT == type)
+    {
+        result = events.generate(type);
+    }
+
+    return result;
+}
+
+QByteArray Script::generateHead(const ScriptType type) const
+{
+    QByteArray result;
+
     if (SCR_ASS == type || SCR_SSA == type)
     {
         if (_before.length())
         {
-            result.append( _before.join("\n") );
-            result.append("\n");
+            result = _before.join('\n');
+            result.append('\n');
         }
 
-        result.append( header.generate(type) );
-        result.append("\n");
-        result.append( styles.generate(type) );
-        result.append("\n");
-        result.append( events.generate(type) );
-
-        if (!fonts.isEmpty())
+        if (SCR_ASS == type)
         {
-            result.append("\n");
-            result.append( fonts.generate(type) );
+            result.append( header.generateUtf8<SCR_ASS>() );
+            result.append('\n');
+            result.append( styles.generateUtf8<SCR_ASS>() );
         }
-
-        if (!graphics.isEmpty())
+        else
         {
-            result.append("\n");
-            result.append( graphics.generate(type) );
+            result.append( header.generateUtf8<SCR_SSA>() );
+            result.append('\n');
+            result.append( styles.generateUtf8<SCR_SSA>() );
         }
+        result.append('\n');
+        result.append( events.generateHead(type) );
+    }
+
+    return result;
+}
+
+// Секции после событий; формат выбран один раз на весь вывод
+template <ScriptType T>
+static void AppendTail(QByteArray& result, const Script& script)
+{
+    result.append( script.events.generateTail(T) );
+
+    if (!script.fonts.isEmpty())
+    {
+        result.append('\n');
+        result.append( script.fonts.generateUtf8<T>() );
+    }
+
+    if (!script.graphics.isEmpty())
+    {
+        result.append('\n');
+        result.append( script.graphics.generateUtf8<T>() );
+    }
+
+    for (const Section<Line::Base>* const section : script.extra)
+    {
+        result.append('\n');
+        result.append( section->generateUtf8<T>() );
+    }
+}
+
+QByteArray Script::generateTail(const ScriptType type) const
+{
+    QByteArray result;
+
+    if (SCR_ASS == type || SCR_SSA == type)
+    {
+        if (SCR_ASS == type) AppendTail<SCR_ASS>(result, *this);
+        else                 AppendTail<SCR_SSA>(result, *this);
 
         if (_after.length())
         {
-            result.append("\n");
-            result.append( _after.join("\n") );
-            result.append("\n");
+            result.append('\n');
+            result.append( _after.join('\n') );
+            result.append('\n');
         }
     }
-    else if (SCR_SRT == type)
-    {
-        result = events.generate(type);
-    }
 
     return result;
 }
@@ -413,20 +1010,19 @@ QString Script::generate(const ScriptType type) const
 //
 // Определение формата
 //
-ScriptType DetectFormat(QTextStream &in)
+// SSA/ASS определяет общее ядро, SRT - регулярка по тем же 5120 символам
+ScriptType DetectFormat(const QByteArray& text)
 {
-    in.seek(0);
-
-    QString str = in.read(5120);
-    if (str.contains(QRegularExpression("ScriptType *: *v4\\.00\\+")))
+    switch ( Lite::DetectFormat(text.constData(), static_cast<size_t>(text.size())) )
     {
-        return SCR_ASS;
+    case Lite::SCR_ASS: return SCR_ASS;
+    case Lite::SCR_SSA: return SCR_SSA;
+    default:            break;
     }
-    else if (str.contains(QRegularExpression("ScriptType *: *v4\\.00")))
-    {
-        return SCR_SSA;
-    }
-    else if (str.contains(QRegularExpression("\\d{2}:\\d{2}:\\d{2},\\d{3} *--> *\\d{2}:\\d{2}:\\d{2},\\d{3}")))
+
+    // Символ UTF-8 занимает не больше 4 байт
+    const QString str = QString::fromUtf8( text.left(5120 * 4) ).left(5120);
+    if (str.contains(QRegularExpression("\\d{2}:\\d{2}:\\d{2},\\d{3} *--> *\\d{2}:\\d{2}:\\d{2},\\d{3}")))
     {
         return SCR_SRT;
     }
@@ -434,548 +1030,120 @@ ScriptType DetectFormat(QTextStream &in)
     return SCR_UNKNOWN;
 }
 
+// Формат по расширению файла
+ScriptType FormatFromSuffix(const QString& suffix)
+{
+    const QString lower = suffix.toLower();
+    if ("ass" == lower) return SCR_ASS;
+    if ("ssa" == lower) return SCR_SSA;
+    if ("srt" == lower) return SCR_SRT;
+    return SCR_UNKNOWN;
+}
+
 //
 // Парсер SSA
 //
-bool ParseSSA(QTextStream& in, Script& script)
-{
-    in.seek(0);
-
-    // Регулярка для определения секции
-    QRegularExpression reSection("^\\[([^\\]]+?)\\]$");
-    QRegularExpressionMatch match;
-
-    // Таблица состояний
-    QHash<QString, SectionType> sectionTable = {
-        {Sections::header.toLower(),    SEC_HEADER},
-        {Sections::stylesSSA.toLower(), SEC_STYLES},
-        {Sections::stylesASS.toLower(), SEC_STYLES},
-        {Sections::events.toLower(),    SEC_EVENTS},
-        {Sections::fonts.toLower(),     SEC_FONTS},
-        {Sections::graphics.toLower(),  SEC_GRAPHICS}
-    };
 
-    // Таблица типов файлов
-    QHash<QString, ScriptType> typeTable = {
-        {"v4.00",  SCR_SSA},
-        {"v4.00+", SCR_ASS},
-        {Sections::stylesSSA.toLower(), SCR_SSA},
-        {Sections::stylesASS.toLower(), SCR_ASS}
-    };
+// Строки общего разбора собираются сразу в модель Qt
+class ScriptHandler : public Lite::Handler
+{
+public:
+    explicit ScriptHandler(Script& script) :
+        _script(script),
+        _extra(nullptr)
+    {}
 
-    // Имена строк
-    const QString ltStyle      = "style";
-    const QString ltEvent      = "dialogue";
-    const QString ltFormat     = "format";
-    const QString ltScriptType = "scripttype";
-
-    QString line, name, text, tempStr;
-    SectionType state = SEC_UNKNOWN;
-    QStringList tempStrList, tempList;
-    bool readNext = true, atBegin = true;
-    ScriptType type = SCR_SSA;
-    int pos;
-    while ( !in.atEnd() )
+    void before(Lite::Lines& lines) override
     {
-        // Если вернулись из секции, имя новой секции надо сохранить
-        if (readNext)
-        {
-            line = in.readLine().trimmed();
-        }
-        else
-        {
-            readNext = true;
-        }
-
-        // Пропускаем пустые строки, чтобы не делать проверки дальше
-        if (!atBegin && line.isEmpty()) continue;
-
-        switch (state)
-        {
-        // Вне секций
-        case SEC_UNKNOWN:
-            // Нашли заголовок
-            if ((match = reSection.match(line)).hasMatch())
-            {
-                tempStr = match.captured(1).trimmed().toLower();
-
-                // Есть ли такой заголовок в таблице?
-                if (sectionTable.contains(tempStr))
-                {
-                    state = sectionTable[tempStr];
-
-                    // Заголовок с версией файла?
-                    if (typeTable.contains(tempStr))
-                    {
-                        type = typeTable[tempStr];
-                    }
-
-                    // В начале файла
-                    if (atBegin)
-                    {
-                        atBegin = false;
-                        script.appendBefore(tempStrList);
-                        tempStrList.clear();
-                    }
-                }
-            }
-
-            // Спасаем неизвестное
-            //! @todo: временно отключено - мусор ломает формат
-            /*if (SEC_UNKNOWN == state)
-            {
-                tempStrList.append(line);
-            }*/
-            break;
-
-        case SEC_HEADER:
-            // Такой комментарий может быть только в заголовке
-            if ( line.startsWith(';') )
-            {
-                tempStrList.append(line);
-            }
-            // Началась другая секция
-            else if (reSection.match(line).hasMatch())
-            {
-                script.header.appendAfter(tempStrList);
-                tempStrList.clear();
+        _script.appendBefore( ToByteArrays(lines) );
+    }
 
-                readNext = false;
-                state = SEC_UNKNOWN;
-            }
-            // Нормальная строка
-            else if ( -1 != ( pos = line.indexOf(':') ) )
-            {
-                name = line.left(pos).trimmed();
-                text = line.mid(pos + 1).trimmed();
-
-                // Версия файла (шо, опять?)
-                if (ltScriptType == name.toLower())
-                {
-                    tempStr = text.toLower();
-                    if (typeTable.contains(tempStr))
-                    {
-                        type = typeTable[tempStr];
-                    }
-                }
-                else
-                {
-                    Line::Named* ptr = new Line::Named(name, tempStrList);
-                    tempStrList.clear();
-
-                    ptr->text = line.mid(pos + 1).trimmed();
-                    script.header.append(ptr);
-                }
-            }
-            // Мусор
-            else
-            {
-                tempStrList.append(line);
-            }
-            break;
+    void header(Lite::Named& line) override
+    {
+        Line::Named* ptr = new Line::Named(QString::fromStdString(line.name), ToByteArrays(line.before));
+        ptr->setTextUtf8( QByteArray(line.text.data(), static_cast<int>(line.text.size())) );
+        _script.header.append(ptr);
+    }
 
-        case SEC_STYLES:
-            // Началась другая секция
-            if (reSection.match(line).hasMatch())
-            {
-                script.styles.appendAfter(tempStrList);
-                tempStrList.clear();
+    void style(Lite::Style& line) override
+    {
+        _script.styles.append(new Line::Style(line));
+    }
 
-                readNext = false;
-                state = SEC_UNKNOWN;
-            }
-            // Нормальная строка
-            else if ( -1 != ( pos = line.indexOf(':') ) )
-            {
-                name = line.left(pos).trimmed();
-                text = line.mid(pos + 1).trimmed();
-
-                tempStr = name.toLower();
-                // Строка стиля
-                if (ltStyle == tempStr)
-                {
-                    Line::Style* ptr = new Line::Style(tempStrList);
-                    tempStrList.clear();
-
-                    tempList = text.split(',');
-
-                    // Пытаемся спасти большую часть строки
-                    // Name
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->styleName = tempList.first().trimmed();
-                        tempList.removeFirst();
-                    }
-
-                    // Fontname
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->fontName = tempList.first().trimmed();
-                        tempList.removeFirst();
-                    }
-
-                    // Fontsize
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->fontSize = tempList.first().trimmed().toDouble();
-                        tempList.removeFirst();
-                    }
-
-                    // PrimaryColour
-                    if (!tempList.isEmpty())
-                    {
-                        tempStr = tempList.first().trimmed();
-                        if ( tempStr.startsWith("&H") )
-                        {
-                            ptr->primaryColour = tempStr.mid(2).toUInt(nullptr, 16);
-                        }
-                        else
-                        {
-                            ptr->primaryColour = static_cast<quint32>( tempStr.toInt() );
-                        }
-                        tempList.removeFirst();
-                    }
-
-                    // SecondaryColour
-                    if (!tempList.isEmpty())
-                    {
-                        tempStr = tempList.first().trimmed();
-                        if ( tempStr.startsWith("&H") )
-                        {
-                            ptr->secondaryColour = tempStr.mid(2).toUInt(nullptr, 16);
-                        }
-                        else
-                        {
-                            ptr->secondaryColour = static_cast<uint>( tempStr.toInt() );
-                        }
-                        tempList.removeFirst();
-                    }
-
-                    // OutlineColour
-                    if (!tempList.isEmpty())
-                    {
-                        tempStr = tempList.first().trimmed();
-                        if ( tempStr.startsWith("&H") )
-                        {
-                            ptr->outlineColour = tempStr.mid(2).toUInt(nullptr, 16);
-                        }
-                        else
-                        {
-                            ptr->outlineColour = static_cast<uint>( tempStr.toInt() );
-                        }
-                        tempList.removeFirst();
-                    }
-
-                    // BackColour
-                    if (!tempList.isEmpty())
-                    {
-                        tempStr = tempList.first().trimmed();
-                        if ( tempStr.startsWith("&H") )
-                        {
-                            ptr->backColour = tempStr.mid(2).toUInt(nullptr, 16);
-                        }
-                        else
-                        {
-                            ptr->backColour = static_cast<uint>( tempStr.toInt() );
-                        }
-                        tempList.removeFirst();
-                    }
-
-                    // Bold
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->bold = tempList.first().trimmed().toInt() != 0;
-                        tempList.removeFirst();
-                    }
-
-                    // Italic
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->italic = tempList.first().trimmed().toInt() != 0;
-                        tempList.removeFirst();
-                    }
-
-                    if (SCR_ASS == type)
-                    {
-                        // Underline
-                        if (!tempList.isEmpty())
-                        {
-                            ptr->underline = tempList.first().trimmed().toInt() != 0;
-                            tempList.removeFirst();
-                        }
-
-                        // StrikeOut
-                        if (!tempList.isEmpty())
-                        {
-                            ptr->strikeOut = tempList.first().trimmed().toInt() != 0;
-                            tempList.removeFirst();
-                        }
-
-                        // ScaleX
-                        if (!tempList.isEmpty())
-                        {
-                            ptr->scaleX = tempList.first().trimmed().toDouble();
-                            tempList.removeFirst();
-                        }
-
-                        // ScaleY
-                        if (!tempList.isEmpty())
-                        {
-                            ptr->scaleY = tempList.first().trimmed().toDouble();
-                            tempList.removeFirst();
-                        }
-
-                        // Spacing
-                        if (!tempList.isEmpty())
-                        {
-                            ptr->spacing = tempList.first().trimmed().toDouble();
-                            tempList.removeFirst();
-                        }
-
-                        // Angle
-                        if (!tempList.isEmpty())
-                        {
-                            ptr->angle = tempList.first().trimmed().toDouble();
-                            tempList.removeFirst();
-                        }
-                    }
-
-                    // BorderStyle
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->borderStyle = tempList.first().trimmed().toUShort();
-                        tempList.removeFirst();
-                    }
-
-                    // Outline
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->outline = tempList.first().trimmed().toDouble();
-                        tempList.removeFirst();
-                    }
-
-                    // Shadow
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->shadow = tempList.first().trimmed().toDouble();
-                        tempList.removeFirst();
-                    }
-
-                    // Alignment
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->alignment = tempList.first().trimmed().toUShort();
-                        if (SCR_SSA == type && ptr->alignment > 0 && ptr->alignment < Line::AlignmentSSA.length())
-                        {
-                            ptr->alignment = Line::AlignmentSSA.at(ptr->alignment);
-                        }
-
-                        if (ptr->alignment < 1 || ptr->alignment > 9)
-                        {
-                            ptr->alignment = 2;
-                        }
-
-                        tempList.removeFirst();
-                    }
-
-                    // MarginL
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->marginL = tempList.first().trimmed().toUShort();
-                        tempList.removeFirst();
-                    }
-
-                    // MarginR
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->marginR = tempList.first().trimmed().toUShort();
-                        tempList.removeFirst();
-                    }
-
-                    // MarginV
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->marginV = tempList.first().trimmed().toUShort();
-                        tempList.removeFirst();
-                    }
-
-                    if (SCR_SSA == type)
-                    {
-                        // AlphaLevel
-                        tempList.removeFirst();
-                    }
-
-                    // Encoding
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->encoding = tempList.first().trimmed().toUShort();
-                    }
-
-                    script.styles.append(ptr);
-                }
-                // Строка формата - пропускаем
-                else if (ltFormat == tempStr) {}
-                // Мусор
-                else
-                {
-                    tempStrList.append(line);
-                }
-            }
-            // Мусор
-            else
-            {
-                tempStrList.append(line);
-            }
-            break;
+    // Строка со всеми полями хранится как есть и разбирается при первом обращении
+    void event(Lite::Lines& before, const std::string& line, const size_t colon) override
+    {
+        size_t textPos;
+        const Lite::ScriptType type = Lite::SplitEvent(line, colon, textPos);
+        if (Lite::SCR_UNKNOWN != type)
+        {
+            Line::Event* ptr = new Line::Event(&_script.names, ToByteArrays(before),
+                                               QByteArray(line.data(), static_cast<int>(textPos + 1)),
+                                               Lite::SCR_SSA == type ? SCR_SSA : SCR_ASS);
+            ptr->setTextUtf8( QByteArray(line.data() + textPos + 1, static_cast<int>(line.size() - textPos - 1)) );
+            _script.events.append(ptr);
+            return;
+        }
 
-        case SEC_EVENTS:
-            // Началась другая секция
-            if (reSection.match(line).hasMatch())
-            {
-                script.events.appendAfter(tempStrList);
-                tempStrList.clear();
+        Lite::Event e;
+        Lite::ParseEvent(line, colon, e);
+
+        Line::Event* ptr = new Line::Event(&_script.names, ToByteArrays(before));
+        ptr->setLayer(e.layer);
+        ptr->setStart(e.start);
+        ptr->setEnd(e.end);
+        ptr->setMarginL(e.marginL);
+        ptr->setMarginR(e.marginR);
+        ptr->setMarginV(e.marginV);
+        ptr->setStyle( QString::fromStdString(e.style) );
+        ptr->setActorName( QString::fromStdString(e.actorName) );
+        ptr->setEffect( QString::fromStdString(e.effect) );
+        ptr->setTextUtf8( QByteArray(e.text.data(), static_cast<int>(e.text.size())) );
+        _script.events.append(ptr);
+    }
 
-                readNext = false;
-                state = SEC_UNKNOWN;
-            }
-            // Нормальная строка
-            else if ( -1 != ( pos = line.indexOf(':') ) )
-            {
-                name = line.left(pos).trimmed();
-                text = line.mid(pos + 1).trimmed();
-
-                tempStr = name.toLower();
-                // Строка события
-                if (ltEvent == tempStr)
-                {
-                    Line::Event* ptr = new Line::Event(tempStrList);
-                    tempStrList.clear();
-
-                    tempList = text.split(',');
-
-                    // Пытаемся спасти большую часть строки
-                    // Layer
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->layer = tempList.first().remove(QRegularExpression("\\D")).toUInt();
-                        tempList.removeFirst();
-                    }
-
-                    // Start
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->start = Line::StrToTime(tempList.first(), type);
-                        tempList.removeFirst();
-                    }
-
-                    // End
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->end = Line::StrToTime(tempList.first(), type);
-                        tempList.removeFirst();
-                    }
-
-                    // Style
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->style = tempList.first().trimmed();
-                        tempList.removeFirst();
-                    }
-
-                    // Name
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->actorName = tempList.first().trimmed();
-                        tempList.removeFirst();
-                    }
-
-                    // MarginL
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->marginL = tempList.first().trimmed().toUShort();
-                        tempList.removeFirst();
-                    }
-
-                    // MarginR
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->marginR = tempList.first().trimmed().toUShort();
-                        tempList.removeFirst();
-                    }
-
-                    // MarginV
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->marginV = tempList.first().trimmed().toUShort();
-                        tempList.removeFirst();
-                    }
-
-                    // Effect
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->effect = tempList.first().trimmed();
-                        tempList.removeFirst();
-                    }
-
-                    // Text
-                    if (!tempList.isEmpty())
-                    {
-                        ptr->text = tempList.join(',');
-                    }
-
-                    script.events.append(ptr);
-                }
-                // Строка формата - пропускаем
-                else if (ltFormat == tempStr) {}
-                // Мусор
-                else
-                {
-                    tempStrList.append(line);
-                }
-            }
-            // Мусор
-            else
-            {
-                tempStrList.append(line);
-            }
-            break;
+    void sectionAfter(const Lite::SectionType section, Lite::Lines& lines) override
+    {
+        switch (section)
+        {
+        case Lite::SEC_HEADER: _script.header.appendAfter( ToByteArrays(lines) ); break;
+        case Lite::SEC_STYLES: _script.styles.appendAfter( ToByteArrays(lines) ); break;
+        case Lite::SEC_EVENTS: _script.events.appendAfter( ToByteArrays(lines) ); break;
+        default: break;
+        }
+    }
 
-        case SEC_FONTS:
-            // Началась другая секция
-            if (reSection.match(line).hasMatch())
-            {
-                readNext = false;
-                state = SEC_UNKNOWN;
-            }
-            // Контент
-            else
-            {
-                script.fonts.append(new Line::Base(line));
-            }
-            break;
+    void extra(const std::string& name) override
+    {
+        _extra = new Section<Line::Base>( QString::fromStdString(name) );
+        _script.extra.append(_extra);
+    }
 
-        case SEC_GRAPHICS:
-            // Началась другая секция
-            if (reSection.match(line).hasMatch())
-            {
-                readNext = false;
-                state = SEC_UNKNOWN;
-            }
-            // Контент
-            else
-            {
-                script.graphics.append(new Line::Base(line));
-            }
-            break;
+    void content(const Lite::SectionType section, std::string& line) override
+    {
+        Line::Base* const ptr = new Line::Base( QByteArray(line.data(), static_cast<int>(line.size())) );
+        switch (section)
+        {
+        case Lite::SEC_FONTS:    _script.fonts.append(ptr); break;
+        case Lite::SEC_GRAPHICS: _script.graphics.append(ptr); break;
+        default:                 _extra->append(ptr); break;
         }
     }
 
-    // Спасаем мусор в конце файла
-    if (tempStrList.length())
+    void after(Lite::Lines& lines) override
     {
-        script.appendAfter(tempStrList);
+        _script.appendAfter( ToByteArrays(lines) );
     }
 
+private:
+    Script&               _script;
+    Section<Line::Base>*  _extra;
+};
+
+bool ParseSSA(const QByteArray& text, Script& script)
+{
+    ScriptHandler handler(script);
+    Lite::ParseSSA(text.constData(), static_cast<size_t>(text.size()), handler);
     return true;
 }
 
@@ -984,21 +1152,76 @@ bool ParseSSA(QTextStream& in, Script& script)
 //
 enum SRTState {SRTST_EMPTY, SRTST_NEW, SRTST_TEXT};
 
-bool ParseSRT(QTextStream& in, Script& script)
+// Номер фразы: только цифры
+static bool IsSRTIndex(const QString& line)
 {
-    in.seek(0);
+    if (line.isEmpty()) return false;
+    for (const QChar c : line)
+    {
+        if (c < '0' || c > '9') return false;
+    }
+    return true;
+}
 
-    // Идея: можно просто разбить файл, используя два перевода строки (и номер, и время) - медленно
+// Время "00:00:00,000" по фиксированным смещениям, с проверкой каждого символа
+static bool ParseSRTTime(const QChar* p, uint& time)
+{
+    static const char pattern[] = "00:00:00,000";
+    uint digits[9], n = 0;
+    for (int i = 0; i < 12; ++i)
+    {
+        const ushort c = p[i].unicode();
+        if ('0' == pattern[i])
+        {
+            if (c < '0' || c > '9') return false;
+            digits[n++] = c - '0';
+        }
+        else if (c != static_cast<ushort>(pattern[i]) && !(',' == pattern[i] && '.' == c))
+        {
+            return false;
+        }
+    }
 
-    // Регулярка для определения секции
-    QRegularExpression reTime("^(\\d{2}:\\d{2}:\\d{2},\\d{3}) *--> *(\\d{2}:\\d{2}:\\d{2},\\d{3})$");
-    QRegularExpressionMatch match;
+    time = (((digits[0] * 10u + digits[1]) * 60u + digits[2] * 10u + digits[3]) * 60u + digits[4] * 10u + digits[5]) * 1000u
+         + digits[6] * 100u + digits[7] * 10u + digits[8];
+    return true;
+}
+
+// "00:00:00,000 --> 00:00:00,000", после второго времени допускаются координаты
+static bool ParseSRTTiming(const QString& line, uint& start, uint& end)
+{
+    const QChar* const data = line.constData();
+    const int len = line.length();
+    if (len < 12 + 3 + 12 || !ParseSRTTime(data, start)) return false;
+
+    int pos = 12;
+    while (pos < len && ' ' == data[pos]) ++pos;
+    if (pos + 3 > len || '-' != data[pos] || '-' != data[pos + 1] || '>' != data[pos + 2]) return false;
+    pos += 3;
+    while (pos < len && ' ' == data[pos]) ++pos;
+    if (pos + 12 > len || !ParseSRTTime(data + pos, end)) return false;
+
+    pos += 12;
+    return pos == len || data[pos].isSpace();
+}
 
-    QString line;
-    QStringList tempList;
+bool ParseSRT(const QByteArray& utf8, Script& script)
+{
+    QString source = QString::fromUtf8(utf8);
+    QTextStream in(&source, QIODevice::ReadOnly);
+
+    QString line, text;
     SRTState state = SRTST_EMPTY;
-    bool isNumber;
     uint start = 0, end = 0;
+    auto appendEvent = [&]() {
+        Line::Event* ptr = new Line::Event(&script.names);
+        ptr->setStart(start);
+        ptr->setEnd(end);
+        ptr->setText(text);
+        script.events.append(ptr);
+        text.clear();
+    };
+
     while ( !in.atEnd() )
     {
         line = in.readLine().trimmed();
@@ -1008,32 +1231,9 @@ bool ParseSRT(QTextStream& in, Script& script)
         case SRTST_EMPTY:
             // Пустая строка - пропускаем
             if (line.isEmpty()) {}
-            else
+            else if (IsSRTIndex(line))
             {
-                line.toInt(&isNumber);
-                if (isNumber)
-                {
-                    state = SRTST_NEW;
-                }
-                else
-                {
-                    return false;
-                }
-            }
-            break;
-
-        case SRTST_NEW:
-            // Пустая строка - ошибка
-            if (line.isEmpty())
-            {
-                return false;
-            }
-            else if ((match = reTime.match(line)).hasMatch())
-            {
-                state = SRTST_TEXT;
-
-                start = Line::StrToTime(match.captured(1), SCR_SRT);
-                end   = Line::StrToTime(match.captured(2), SCR_SRT);
+                state = SRTST_NEW;
             }
             else
             {
@@ -1041,50 +1241,40 @@ bool ParseSRT(QTextStream& in, Script& script)
             }
             break;
 
+        case SRTST_NEW:
+            // Только строка времени, пустая - ошибка
+            if ( !ParseSRTTiming(line, start, end) ) return false;
+            state = SRTST_TEXT;
+            break;
+
         case SRTST_TEXT:
             // Пустая строка - фраза закончилась
             if (line.isEmpty())
             {
                 state = SRTST_EMPTY;
-
-                if (!tempList.isEmpty())
-                {
-                    Line::Event* ptr = new Line::Event();
-                    ptr->start = start;
-                    ptr->end = end;
-                    ptr->text = tempList.join("\\N");
-                    script.events.append(ptr);
-                    tempList.clear();
-                }
+                if (!text.isEmpty()) appendEvent();
             }
             else
             {
-                tempList.append(line);
+                if (!text.isEmpty()) text.append("\\N");
+                text.append(line);
             }
             break;
         }
     }
-    if (!tempList.isEmpty())
-    {
-        Line::Event* ptr = new Line::Event();
-        ptr->start = start;
-        ptr->end = end;
-        ptr->text = tempList.join("\\N");
-        script.events.append(ptr);
-        tempList.clear();
-    }
+    if (!text.isEmpty()) appendEvent();
 
     // Важные заголовки
     Line::Named* ptr = new Line::Named("WrapStyle", QStringList("; Script generated by Re_Sync 2"));
-    ptr->text = "0";
+    ptr->setText("0");
     script.header.append(ptr);
 
     ptr = new Line::Named("ScaledBorderAndShadow");
-    ptr->text = "yes";
+    ptr->setText("yes");
     script.header.append(ptr);
 
     ptr = new Line::Named("Collisions");
-    ptr->text = "Normal";
+    ptr->setText("Normal");
     script.header.append(ptr);
 
     // Стиль по умолчанию
@@ -23,13 +23,16 @@
 #include <QList>
 #include <QString>
 #include <QStringList>
+#include <QByteArrayList>
+#include <QHash>
 #include <QTextStream>
+#include "litescript.h"
 
 
 namespace Script
 {
 enum ScriptType {SCR_UNKNOWN, SCR_ASS, SCR_SSA, SCR_SRT};
-enum SectionType {SEC_UNKNOWN, SEC_HEADER, SEC_STYLES, SEC_EVENTS, SEC_FONTS, SEC_GRAPHICS};
+enum SectionType {SEC_UNKNOWN, SEC_HEADER, SEC_STYLES, SEC_EVENTS, SEC_FONTS, SEC_GRAPHICS, SEC_EXTRA};
 
 namespace Sections
 {
@@ -41,14 +44,54 @@ const QString fonts     = "Fonts";
 const QString graphics  = "Graphics";
 }
 
-namespace Line
+// Таблица уникальных строк одного поля событий.
+// Событие хранит только номер строки, таблица считает ссылки.
+class StringPool
 {
-const QVector<ushort> AlignmentSSA = {0, 1, 2, 3, 0, 7, 8, 9, 0, 4, 5, 6};
-const QVector<ushort> AlignmentASS = {0, 1, 2, 3, 9, 10, 11, 5, 6, 7};
+public:
+    typedef int Id;
+
+    Id intern(const QString& str);
+    Id find(const QString& str) const;
+    const QString& at(const Id id) const;
+    int count() const;
+    int usage(const Id id) const;
+    bool rename(const Id id, const QString& str);
+
+    void ref(const Id id);
+    void deref(const Id id);
+
+private:
+    QVector<QString>    _strings;
+    QVector<int>        _usage;
+    QHash<QString, Id>  _index;
+};
+
+// У стиля, актёра и эффекта свои таблицы: поиск и переименование
+// в одной не задевают одноимённые строки других полей
+struct EventNames
+{
+    StringPool styles;
+    StringPool actors;
+    StringPool effects;
+};
+
+// Строки модели хранятся в UTF-8, QString получается по запросу
+QByteArrayList ToUtf8(const QStringList& list);
+QStringList FromUtf8(const QByteArrayList& list);
 
+// Разбор и вывод SSA/ASS общие с SubCleanerLite (litescript.h)
+Lite::ScriptType ToLite(const ScriptType type);
+Lite::SectionType ToLite(const SectionType section);
+
+namespace Line
+{
 const QString defaultStyle = "Default";
 const QString defaultFont = "Arial";
 
+// Формат известен при компиляции; версии с type выбирают специализацию
+template <ScriptType T> uint StrToTime(const QString& str);
+template <ScriptType T> QString TimeToStr(const uint time);
 uint StrToTime(const QString& str, const ScriptType type);
 QString TimeToStr(const uint time, const ScriptType type);
 
@@ -58,31 +101,66 @@ class Base
 public:
     Base();
     Base(const QString& value);
+    Base(const QByteArray& value);
 
+    QString value() const;
     QString generate(const ScriptType type) const;
 
+    template <ScriptType T>
+    QString generateAs() const
+    {
+        return this->value();
+    }
+
+    template <ScriptType T>
+    QByteArray generateUtf8() const
+    {
+        return _value;
+    }
+
 private:
-    QString _value;
+    QByteArray _value;
 };
 
 // Простейшая строка с двоеточием
 class Named : public Base
 {
 public:
-    QString text;
-
     Named(const QString& name);
     Named(const QString& name, const QStringList& before);
+    Named(const QString& name, const QByteArrayList& before);
 
     void clearBefore();
     QString name() const;
+    QStringList before() const;
+    QString text() const;
+    void setText(const QString& text);
+    // Без перекодирования
+    const QByteArray& textUtf8() const;
+    void setTextUtf8(const QByteArray& text);
     QString generate(const ScriptType type) const;
 
-protected:
-    QString     _name;
-    QStringList _before;
+    template <ScriptType T>
+    QString generateAs() const
+    {
+        return QString::fromUtf8( this->generateUtf8<T>() );
+    }
+
+    template <ScriptType T>
+    QByteArray generateUtf8() const
+    {
+        return SCR_ASS == T || SCR_SSA == T ? this->generateLine(_text) : QByteArray();
+    }
 
-    QString generate(const ScriptType type, const QString& value) const;
+protected:
+    QString         _name;
+    QByteArray      _text;
+    QByteArrayList  _before;
+
+    // Комментарии перед строкой, каждый с переводом строки
+    QByteArray generateBefore() const;
+    // Строка SSA/ASS "Имя: значение" с комментариями перед ней
+    QByteArray generateLine(const QByteArray& value) const;
 };
 
 // Строка стиля
@@ -115,34 +193,91 @@ public:
 
     Style();
     Style(const QStringList& before);
+    // Поля из общего разбора
+    Style(const Lite::Style& other);
 
     QString generate(const ScriptType type) const;
+    template <ScriptType T> QString generateAs() const;
+    template <ScriptType T> QByteArray generateUtf8() const;
 
 private:
     void init();
 };
 
-// Строка события
+// Строка события. Строка из файла хранится как есть и разбирается при первом
+// обращении к полям, которое пишет в общие таблицы Script::names. Поэтому
+// читать события одного скрипта из нескольких потоков можно только после
+// Script::parseEvents() (её вызывает Engine::clean).
 class Event : public Named
 {
 public:
-    uint        layer;
-    uint        start;
-    uint        end;
-    QString     style;
-    QString     actorName;
-    ushort      marginL;
-    ushort      marginR;
-    ushort      marginV;
-    QString     effect;
-
-    Event();
-    Event(const QStringList& before);
+    Event(EventNames* names);
+    Event(EventNames* names, const QStringList& before);
+    Event(EventNames* names, const QByteArrayList& before);
+    // Строка из файла: поля разбираются из prefix при первом обращении
+    Event(EventNames* names, const QByteArrayList& before, const QByteArray& prefix, const ScriptType type);
+    Event(const Event& other);
+    ~Event();
+    Event& operator=(const Event& other);
+
+    // Разбор полей заранее: до него имена не попадают в пул
+    void parse() const;
+
+    uint layer() const;
+    uint start() const;
+    uint end() const;
+    ushort marginL() const;
+    ushort marginR() const;
+    ushort marginV() const;
+    void setLayer(const uint layer);
+    void setStart(const uint start);
+    void setEnd(const uint end);
+    void setMarginL(const ushort marginL);
+    void setMarginR(const ushort marginR);
+    void setMarginV(const ushort marginV);
+
+    QString style() const;
+    QString actorName() const;
+    QString effect() const;
+    StringPool::Id styleId() const;
+    StringPool::Id actorId() const;
+    StringPool::Id effectId() const;
+    void setStyle(const QString& style);
+    void setActorName(const QString& actorName);
+    void setEffect(const QString& effect);
+
+    // Исходная строка до текста ("Dialogue: 0,...,Effect,"). Пока поля не менялись,
+    // вывод в формате исходной строки копирует её без сборки.
+    const QByteArray& rawPrefix() const;
+    // Запоминает текущие поля как исходные
+    void setRawPrefix(const QByteArray& prefix);
 
     QString generate(const ScriptType type) const;
+    template <ScriptType T> QString generateAs() const;
+    // Сразу в UTF-8: исходные строки не перекодируются
+    template <ScriptType T> QByteArray generateUtf8() const;
 
 private:
+    EventNames*     _names;
+    QByteArray      _rawPrefix;
+    ScriptType      _rawType;
+
+    // Заполняются parse(), в том числе из const-методов
+    mutable bool            _parsed;
+    mutable uint            _layer;
+    mutable uint            _start;
+    mutable uint            _end;
+    mutable ushort          _marginL;
+    mutable ushort          _marginR;
+    mutable ushort          _marginV;
+    mutable StringPool::Id  _style;
+    mutable StringPool::Id  _actorName;
+    mutable StringPool::Id  _effect;
+
     void init();
+    void clearRaw();
+    template <typename V> void change(V& field, const V value);
+    void assign(StringPool& pool, StringPool::Id& field, const QString& value);
 };
 }
 
@@ -155,6 +290,7 @@ public:
 
     Section(const Section<T> &original) :
         _sectionType(original._sectionType),
+        _name(original._name),
         _after(original._after)
     {
         for (const T* const e : original.content) content.append(new T(*e));
@@ -162,6 +298,11 @@ public:
     Section(const SectionType sectionType) :
         _sectionType(sectionType)
     {}
+    // Неизвестная секция, сохраняется как есть
+    Section(const QString& name) :
+        _sectionType(SEC_EXTRA),
+        _name(name)
+    {}
 
     ~Section()
     {
@@ -186,6 +327,11 @@ public:
     }
 
     void appendAfter(const QStringList& after)
+    {
+        _after.append( ToUtf8(after) );
+    }
+
+    void appendAfter(const QByteArrayList& after)
     {
         _after.append(after);
     }
@@ -195,86 +341,79 @@ public:
         content.append(ptr);
     }
 
-    QString generate(const ScriptType type) const
+    QString name() const
     {
-        QString result;
+        return _name;
+    }
 
-        if (SCR_ASS == type || SCR_SSA == type)
+    QStringList after() const
+    {
+        return FromUtf8(_after);
+    }
+
+    // Заголовок секции (до строк)
+    QByteArray generateHead(const ScriptType type) const
+    {
+        QByteArray result;
+
+        if ( (SCR_ASS == type || SCR_SSA == type) && SEC_UNKNOWN != _sectionType )
         {
-            switch (_sectionType)
-            {
-            case SEC_HEADER:
-                result.append( QString("[%1]\n").arg(Sections::header) );
-                break;
-
-            case SEC_STYLES:
-                if (SCR_ASS == type)
-                {
-                    result.append( QString("[%1]\n").arg(Sections::stylesASS) );
-                    result.append("Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n");
-                }
-                else
-                {
-                    result.append( QString("[%1]\n").arg(Sections::stylesSSA) );
-                    result.append("Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, TertiaryColour, BackColour, Bold, Italic, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, AlphaLevel, Encoding\n");
-                }
-                break;
-
-            case SEC_EVENTS:
-                result.append( QString("[%1]\n").arg(Sections::events) );
-                if (SCR_ASS == type)
-                {
-                    result.append("Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n");
-                }
-                else
-                {
-                    result.append("Format: Marked, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n");
-                }
-                break;
-
-            case SEC_FONTS:
-                result.append( QString("[%1]\n").arg(Sections::fonts) );
-                break;
-
-            case SEC_GRAPHICS:
-                result.append( QString("[%1]\n").arg(Sections::graphics) );
-                break;
-
-            default:
-                break;
-            }
+            if (SEC_EXTRA == _sectionType) result = '[' + _name.toUtf8() + "]\n";
+            else result = Lite::SectionHead( ToLite(_sectionType), ToLite(type) );
+        }
 
-            for (const T* const e : qAsConst(content))
-            {
-                result.append( e->generate(type) );
-                result.append("\n");
-            }
+        return result;
+    }
+
+    // Окончание секции (после строк)
+    QByteArray generateTail(const ScriptType type) const
+    {
+        QByteArray result;
 
+        if (SCR_ASS == type || SCR_SSA == type)
+        {
             // Уродливый костыль
             if (SEC_HEADER == _sectionType)
             {
-                if (SCR_ASS == type)
-                {
-                    result.append("ScriptType: v4.00+\n");
-                }
-                else
-                {
-                    result.append("ScriptType: v4.00\n");
-                }
+                result.append( Lite::ScriptTypeLine(ToLite(type)) );
             }
 
             if (_after.length())
             {
-                result.append( _after.join("\n") );
-                result.append("\n");
+                result.append( _after.join('\n') );
+                result.append('\n');
             }
         }
-        else if (SCR_SRT == type && SEC_EVENTS == _sectionType)
+
+        return result;
+    }
+
+    QString generate(const ScriptType type) const
+    {
+        switch (type)
+        {
+        case SCR_SSA: return this->generateAs<SCR_SSA>();
+        case SCR_ASS: return this->generateAs<SCR_ASS>();
+        case SCR_SRT: return this->generateAs<SCR_SRT>();
+        default:      return QString();
+        }
+    }
+
+    template <ScriptType F>
+    QString generateAs() const
+    {
+        QString result;
+
+        if (SCR_ASS == F || SCR_SSA == F)
+        {
+            result = QString::fromUtf8( this->template generateUtf8<F>() );
+        }
+        else if (SCR_SRT == F && SEC_EVENTS == _sectionType)
         {
             for (typename QList<T*>::size_type i = 0, len = content.length(); i < len; ++i)
             {
                 result.append( QString("%1\n").arg(i + 1) );
-                result.append( content.at(i)->generate(type) );
+                result.append( content.at(i)->template generateAs<F>() );
                 result.append("\n\n");
             }
         }
@@ -282,9 +421,30 @@ public:
         return result;
     }
 
+    // SSA/ASS сразу в UTF-8
+    template <ScriptType F>
+    QByteArray generateUtf8() const
+    {
+        QByteArray result;
+
+        if (SCR_ASS == F || SCR_SSA == F)
+        {
+            result.append( this->generateHead(F) );
+            for (const T* const e : qAsConst(content))
+            {
+                result.append( e->template generateUtf8<F>() );
+                result.append('\n');
+            }
+            result.append( this->generateTail(F) );
+        }
+
+        return result;
+    }
+
 private:
     SectionType _sectionType;
-    QStringList _after;
+    QString         _name;
+    QByteArrayList  _after;
 };
 
 // Скрипт
@@ -293,27 +453,45 @@ class Script
 public:
     Script();
 
+    // Объявлена первой, чтобы пережить события
+    EventNames            names;
     Section<Line::Named>  header;
     Section<Line::Style>  styles;
     Section<Line::Event>  events;
     Section<Line::Base>   fonts;
     Section<Line::Base>   graphics;
+    QList<Section<Line::Base>*> extra;
+
+    ~Script();
 
     void clearBefore();
     void clearAfter();
     void clear();
     void appendBefore(const QStringList& before);
     void appendAfter(const QStringList& after);
+    void appendBefore(const QByteArrayList& before);
+    void appendAfter(const QByteArrayList& after);
+    QStringList before() const;
+    QStringList after() const;
+    // Разбирает все отложенные события
+    void parseEvents();
     QString generate(const ScriptType type) const;
+    // Текст SSA/ASS в UTF-8 до первого и после последнего события
+    QByteArray generateHead(const ScriptType type) const;
+    QByteArray generateTail(const ScriptType type) const;
 
 private:
-    QStringList _before;
-    QStringList _after;
+    QByteArrayList _before;
+    QByteArrayList _after;
+
+    Q_DISABLE_COPY(Script)
 };
 
-ScriptType DetectFormat(QTextStream& in);
-bool ParseSSA(QTextStream& in, Script& script);
-bool ParseSRT(QTextStream& in, Script& script);
+ScriptType FormatFromSuffix(const QString& suffix);
+// Текст в UTF-8 без BOM
+ScriptType DetectFormat(const QByteArray& text);
+bool ParseSSA(const QByteArray& text, Script& script);
+bool ParseSRT(const QByteArray& utf8, Script& script);
 void GenerateSSA(QTextStream& out, const Script& script);
 void GenerateASS(QTextStream& out, const Script& script);
 void GenerateSRT(QTextStream& out, const Script& script);
@@ -0,0 +1,265 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "snapshot.h"
+#include <QDataStream>
+#include <QFile>
+#include <limits>
+
+namespace Snapshot
+{
+namespace
+{
+const quint32 magic = 0x5343534E; // "SCSN"
+const quint16 version = 4;
+const QDataStream::Version streamVersion = QDataStream::Qt_5_6;
+
+void WriteLines(QDataStream& out, const Script::Section<Script::Line::Base>& section)
+{
+    QStringList lines;
+    for (const Script::Line::Base* const line : section.content) lines.append( line->value() );
+    out << section.after() << lines;
+}
+
+bool ReadLines(QDataStream& in, Script::Section<Script::Line::Base>& section)
+{
+    QStringList after, lines;
+    in >> after >> lines;
+    for (const QString& line : qAsConst(lines)) section.append(new Script::Line::Base(line));
+    section.appendAfter(after);
+    return QDataStream::Ok == in.status();
+}
+
+// Счётчик записей; защищает от огромных выделений на битых данных
+bool ReadCount(QDataStream& in, const QByteArray& data, qint32& count)
+{
+    in >> count;
+    return QDataStream::Ok == in.status() && count >= 0 && count <= data.size();
+}
+
+QStringList PoolStrings(const Script::StringPool& pool)
+{
+    QStringList result;
+    for (Script::StringPool::Id id = 0, len = pool.count(); id < len; ++id) result.append( pool.at(id) );
+    return result;
+}
+
+bool ReadId(QDataStream& in, const QStringList& names, QString& value)
+{
+    qint32 id;
+    in >> id;
+    if (id < 0 || id >= names.length()) return false;
+    value = names.at(id);
+    return true;
+}
+}
+
+bool IsSnapshot(const QByteArray& head)
+{
+    QDataStream in(head);
+    in.setVersion(streamVersion);
+
+    quint32 value = 0;
+    in >> value;
+    return magic == value;
+}
+
+bool Save(QIODevice* device, const Script::Script& script, const Script::ScriptType type)
+{
+    QDataStream out(device);
+    out.setVersion(streamVersion);
+
+    out << magic << version << static_cast<quint8>(type);
+    out << script.before() << script.after();
+
+    // Таблицы строк событий
+    out << PoolStrings(script.names.styles) << PoolStrings(script.names.actors) << PoolStrings(script.names.effects);
+
+    // Заголовок
+    out << script.header.after() << static_cast<qint32>(script.header.content.length());
+    for (const Script::Line::Named* const line : script.header.content)
+    {
+        out << line->name() << line->before() << line->textUtf8();
+    }
+
+    // Стили
+    out << script.styles.after() << static_cast<qint32>(script.styles.content.length());
+    for (const Script::Line::Style* const s : script.styles.content)
+    {
+        out << s->before() << s->styleName << s->fontName << s->fontSize
+            << s->primaryColour << s->secondaryColour << s->outlineColour << s->backColour
+            << s->bold << s->italic << s->underline << s->strikeOut
+            << s->scaleX << s->scaleY << s->spacing << s->angle
+            << s->borderStyle << s->outline << s->shadow << s->alignment
+            << s->marginL << s->marginR << s->marginV << s->encoding;
+    }
+
+    // События по столбцам
+    const QList<Script::Line::Event*>& events = script.events.content;
+    out << script.events.after() << static_cast<qint32>(events.length());
+    for (const Script::Line::Event* const e : events) out << e->before();
+    for (const Script::Line::Event* const e : events) out << e->layer();
+    for (const Script::Line::Event* const e : events) out << e->start();
+    for (const Script::Line::Event* const e : events) out << e->end();
+    for (const Script::Line::Event* const e : events) out << static_cast<qint32>(e->styleId());
+    for (const Script::Line::Event* const e : events) out << static_cast<qint32>(e->actorId());
+    for (const Script::Line::Event* const e : events) out << static_cast<qint32>(e->effectId());
+    for (const Script::Line::Event* const e : events) out << e->marginL();
+    for (const Script::Line::Event* const e : events) out << e->marginR();
+    for (const Script::Line::Event* const e : events) out << e->marginV();
+    for (const Script::Line::Event* const e : events) out << e->textUtf8();
+    for (const Script::Line::Event* const e : events) out << e->rawPrefix();
+
+    // Вложения и неизвестные секции
+    WriteLines(out, script.fonts);
+    WriteLines(out, script.graphics);
+    out << static_cast<qint32>(script.extra.length());
+    for (const Script::Section<Script::Line::Base>* const section : script.extra)
+    {
+        out << section->name();
+        WriteLines(out, *section);
+    }
+
+    return QDataStream::Ok == out.status();
+}
+
+bool Load(const QByteArray& data, Script::Script& script, Script::ScriptType& type)
+{
+    QDataStream in(data);
+    in.setVersion(streamVersion);
+
+    quint32 fileMagic;
+    quint16 fileVersion;
+    quint8 fileType;
+    in >> fileMagic >> fileVersion >> fileType;
+    if (magic != fileMagic || version != fileVersion || fileType > Script::SCR_SRT) return false;
+    type = static_cast<Script::ScriptType>(fileType);
+
+    QStringList before, after, styleNames, actorNames, effectNames;
+    in >> before >> after >> styleNames >> actorNames >> effectNames;
+    script.appendBefore(before);
+    script.appendAfter(after);
+
+    // Заголовок
+    qint32 count;
+    in >> after;
+    if ( !ReadCount(in, data, count) ) return false;
+    script.header.appendAfter(after);
+    for (qint32 i = 0; i < count; ++i)
+    {
+        QString name;
+        QByteArray text;
+        in >> name >> before >> text;
+        Script::Line::Named* const ptr = new Script::Line::Named(name, before);
+        ptr->setTextUtf8(text);
+        script.header.append(ptr);
+    }
+
+    // Стили
+    in >> after;
+    if ( !ReadCount(in, data, count) ) return false;
+    script.styles.appendAfter(after);
+    for (qint32 i = 0; i < count; ++i)
+    {
+        in >> before;
+        Script::Line::Style* const s = new Script::Line::Style(before);
+        in >> s->styleName >> s->fontName >> s->fontSize
+           >> s->primaryColour >> s->secondaryColour >> s->outlineColour >> s->backColour
+           >> s->bold >> s->italic >> s->underline >> s->strikeOut
+           >> s->scaleX >> s->scaleY >> s->spacing >> s->angle
+           >> s->borderStyle >> s->outline >> s->shadow >> s->alignment
+           >> s->marginL >> s->marginR >> s->marginV >> s->encoding;
+        script.styles.append(s);
+    }
+
+    // События
+    in >> after;
+    if ( !ReadCount(in, data, count) ) return false;
+    script.events.appendAfter(after);
+
+    QList<Script::Line::Event*>& events = script.events.content;
+    events.reserve(count);
+    for (qint32 i = 0; i < count; ++i)
+    {
+        in >> before;
+        events.append(new Script::Line::Event(&script.names, before));
+    }
+
+    QString value;
+    QByteArray text;
+    uint number;
+    ushort margin;
+    for (Script::Line::Event* const e : events) { in >> number; e->setLayer(number); }
+    for (Script::Line::Event* const e : events) { in >> number; e->setStart(number); }
+    for (Script::Line::Event* const e : events) { in >> number; e->setEnd(number); }
+    for (Script::Line::Event* const e : events)
+    {
+        if ( !ReadId(in, styleNames, value) ) return false;
+        e->setStyle(value);
+    }
+    for (Script::Line::Event* const e : events)
+    {
+        if ( !ReadId(in, actorNames, value) ) return false;
+        e->setActorName(value);
+    }
+    for (Script::Line::Event* const e : events)
+    {
+        if ( !ReadId(in, effectNames, value) ) return false;
+        e->setEffect(value);
+    }
+    for (Script::Line::Event* const e : events) { in >> margin; e->setMarginL(margin); }
+    for (Script::Line::Event* const e : events) { in >> margin; e->setMarginR(margin); }
+    for (Script::Line::Event* const e : events) { in >> margin; e->setMarginV(margin); }
+    for (Script::Line::Event* const e : events)
+    {
+        in >> text;
+        e->setTextUtf8(text);
+    }
+    // Исходные строки - после всех полей: они запоминают их значения
+    for (Script::Line::Event* const e : events)
+    {
+        in >> text;
+        e->setRawPrefix(text);
+    }
+
+    // Вложения и неизвестные секции
+    if ( !ReadLines(in, script.fonts) || !ReadLines(in, script.graphics) || !ReadCount(in, data, count) ) return false;
+    for (qint32 i = 0; i < count; ++i)
+    {
+        QString name;
+        in >> name;
+        Script::Section<Script::Line::Base>* const section = new Script::Section<Script::Line::Base>(name);
+        script.extra.append(section);
+        if ( !ReadLines(in, *section) ) return false;
+    }
+
+    return QDataStream::Ok == in.status() && in.atEnd();
+}
+
+bool Load(QFile& file, Script::Script& script, Script::ScriptType& type)
+{
+    const qint64 size = file.size();
+    uchar* const ptr = size > 0 && size <= std::numeric_limits<int>::max() ? file.map(0, size) : nullptr;
+    if (!ptr) return Load(file.readAll(), script, type);
+
+    // Строки при чтении копируются, поэтому отображение можно сразу снять
+    const bool ok = Load(QByteArray::fromRawData(reinterpret_cast<const char*>(ptr), static_cast<int>(size)), script, type);
+    file.unmap(ptr);
+    return ok;
+}
+}
@@ -0,0 +1,43 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "script.h"
+#include <QByteArray>
+
+class QIODevice;
+class QFile;
+
+// Двоичный снимок разобранного скрипта для передачи между этапами обработки.
+// Строки и стили пишутся построчно, события - по столбцам.
+// Загруженный снимок генерируется в точности как исходный скрипт.
+namespace Snapshot
+{
+const QString suffix = ".scsnap";
+
+bool IsSnapshot(const QByteArray& head);
+// События должны быть разобраны (Script::parseEvents): номера строк пишутся до них
+bool Save(QIODevice* device, const Script::Script& script, const Script::ScriptType type);
+bool Load(const QByteArray& data, Script::Script& script, Script::ScriptType& type);
+// Отображает файл в память вместо чтения
+bool Load(QFile& file, Script::Script& script, Script::ScriptType& type);
+}
+
+#endif // SNAPSHOT_H
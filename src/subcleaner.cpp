@@ -0,0 +1,183 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "subcleaner.h"
+#include "engine.h"
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+struct subcleaner_options
+{
+    Engine engine;
+    EventFilter eventFilter;
+    HeaderPolicy headerPolicy;
+};
+
+namespace
+{
+QStringList SplitList(const char *list)
+{
+    return list ? QString::fromUtf8(list).split(',', QString::SkipEmptyParts) : QStringList();
+}
+
+char *CopyBytes(const QByteArray &data)
+{
+    char *const ptr = static_cast<char*>( std::malloc(data.size() + 1) );
+    if (ptr) std::memcpy(ptr, data.constData(), data.size() + 1);
+    return ptr;
+}
+
+void SetError(char **error, const QString &message)
+{
+    if (error) *error = CopyBytes( message.toUtf8() );
+}
+}
+
+extern "C" {
+
+const char *subcleaner_version(void)
+{
+    return "2.0";
+}
+
+subcleaner_options *subcleaner_options_new(unsigned flags)
+{
+    Engine::Options options;
+    if (flags & SUBCLEANER_STRIP_COMMENTS) options |= Engine::StripComments;
+    if (flags & SUBCLEANER_STRIP_INFO)     options |= Engine::StripStyleInfo;
+    if (flags & SUBCLEANER_SORT_EVENTS)    options |= Engine::SortEvents;
+
+    subcleaner_options *const result = new subcleaner_options;
+    result->engine = Engine(options);
+    return result;
+}
+
+void subcleaner_options_free(subcleaner_options *options)
+{
+    delete options;
+}
+
+void subcleaner_strip_tags(subcleaner_options *options, const char *tags)
+{
+    options->engine.setStripTags( SplitList(tags) );
+}
+
+void subcleaner_drop_styles(subcleaner_options *options, const char *patterns)
+{
+    options->eventFilter.addDropStyles( SplitList(patterns) );
+    options->engine.setEventFilter(options->eventFilter);
+}
+
+void subcleaner_keep_styles(subcleaner_options *options, const char *patterns)
+{
+    options->eventFilter.addKeepStyles( SplitList(patterns) );
+    options->engine.setEventFilter(options->eventFilter);
+}
+
+void subcleaner_drop_actors(subcleaner_options *options, const char *patterns)
+{
+    options->eventFilter.addDropActors( SplitList(patterns) );
+    options->engine.setEventFilter(options->eventFilter);
+}
+
+void subcleaner_drop_effects(subcleaner_options *options, const char *patterns)
+{
+    options->eventFilter.addDropEffects( SplitList(patterns) );
+    options->engine.setEventFilter(options->eventFilter);
+}
+
+int subcleaner_drop_layers(subcleaner_options *options, const char *layers)
+{
+    if ( !layers || !options->eventFilter.addDropLayers(QString::fromUtf8(layers)) ) return -1;
+    options->engine.setEventFilter(options->eventFilter);
+    return 0;
+}
+
+void subcleaner_simplify_drawings(subcleaner_options *options, double tolerance)
+{
+    options->engine.setDrawingTolerance(tolerance);
+}
+
+void subcleaner_range(subcleaner_options *options, unsigned start, unsigned end, int rebase)
+{
+    options->engine.setRange(start, end, rebase != 0);
+}
+
+int subcleaner_retime(subcleaner_options *options, long long shift, const char *scale)
+{
+    Timing::Retime retime;
+    if ( scale && !Timing::ParseScale(QString::fromUtf8(scale), retime) ) return -1;
+    retime.shift = shift;
+    options->engine.setRetime(retime);
+    return 0;
+}
+
+int subcleaner_info_rules(subcleaner_options *options, const char *file, char **error)
+{
+    if (!options || !file)
+    {
+        SetError(error, "Invalid arguments.");
+        return -1;
+    }
+
+    QString message;
+    if ( !options->headerPolicy.load(QString::fromUtf8(file), &message) )
+    {
+        SetError(error, message);
+        return -1;
+    }
+    options->engine.setHeaderPolicy(options->headerPolicy);
+    return 0;
+}
+
+int subcleaner_clean(const subcleaner_options *options,
+                     const char *input, size_t input_size,
+                     char **output, size_t *output_size,
+                     char **error)
+{
+    if (!options || !input || !output || input_size > INT_MAX)
+    {
+        SetError(error, "Invalid arguments.");
+        return -1;
+    }
+
+    QByteArray result;
+    QString message;
+    if ( !options->engine.process(QByteArray::fromRawData(input, static_cast<int>(input_size)), result, nullptr, &message) )
+    {
+        SetError(error, message);
+        return -1;
+    }
+
+    *output = CopyBytes(result);
+    if (!*output)
+    {
+        SetError(error, "Out of memory.");
+        return -1;
+    }
+    if (output_size) *output_size = static_cast<size_t>(result.size());
+    return 0;
+}
+
+void subcleaner_free(void *ptr)
+{
+    std::free(ptr);
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SUBCLEANER_H
+#define SUBCLEANER_H
+
+/* Стабильный C-интерфейс библиотеки subcleaner.
+ * Вход и выход - байты в памяти; строки параметров в UTF-8,
+ * списки через запятую, как в опциях командной строки.
+ * Память, выделенная библиотекой, освобождается subcleaner_free().
+ * Разбор, очистка и генерация по отдельности - C++ API в engine.h. */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#  if defined(SUBCLEANER_BUILD)
+#    define SUBCLEANER_API __declspec(dllexport)
+#  else
+#    define SUBCLEANER_API __declspec(dllimport)
+#  endif
+#else
+#  define SUBCLEANER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    SUBCLEANER_STRIP_COMMENTS = 1 << 0,
+    SUBCLEANER_STRIP_INFO     = 1 << 1,
+    SUBCLEANER_SORT_EVENTS    = 1 << 3
+};
+
+typedef struct subcleaner_options subcleaner_options;
+
+SUBCLEANER_API const char *subcleaner_version(void);
+
+SUBCLEANER_API subcleaner_options *subcleaner_options_new(unsigned flags);
+SUBCLEANER_API void subcleaner_options_free(subcleaner_options *options);
+
+SUBCLEANER_API void subcleaner_strip_tags(subcleaner_options *options, const char *tags);
+SUBCLEANER_API void subcleaner_drop_styles(subcleaner_options *options, const char *patterns);
+SUBCLEANER_API void subcleaner_keep_styles(subcleaner_options *options, const char *patterns);
+SUBCLEANER_API void subcleaner_drop_actors(subcleaner_options *options, const char *patterns);
+SUBCLEANER_API void subcleaner_drop_effects(subcleaner_options *options, const char *patterns);
+/* 0 - успех */
+SUBCLEANER_API int subcleaner_drop_layers(subcleaner_options *options, const char *layers);
+SUBCLEANER_API void subcleaner_simplify_drawings(subcleaner_options *options, double tolerance);
+/* Окно времени в миллисекундах; rebase != 0 - сдвинуть окно к нулю */
+SUBCLEANER_API void subcleaner_range(subcleaner_options *options, unsigned start, unsigned end, int rebase);
+/* Сдвиг в миллисекундах и пересчёт частоты кадров ("25:23.976"); 0 - успех */
+SUBCLEANER_API int subcleaner_retime(subcleaner_options *options, long long shift, const char *scale);
+SUBCLEANER_API int subcleaner_info_rules(subcleaner_options *options, const char *file, char **error);
+
+/* Очищает скрипт (текст в любой кодировке или снимок), результат - UTF-8 с BOM.
+ * Одни и те же options можно использовать из нескольких потоков одновременно,
+ * если в это время их не меняют функции subcleaner_* выше.
+ * 0 - успех; иначе *error (если не NULL) получает текст ошибки. */
+SUBCLEANER_API int subcleaner_clean(const subcleaner_options *options,
+                                    const char *input, size_t input_size,
+                                    char **output, size_t *output_size,
+                                    char **error);
+
+SUBCLEANER_API void subcleaner_free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SUBCLEANER_H */
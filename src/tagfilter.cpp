@@ -0,0 +1,260 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "tagfilter.h"
+
+namespace
+{
+// Все теги ASS. Нужны, чтобы отличать \b от \blur и \fn от \fnArial
+const char* const knownTags[] = {
+    "i", "b", "u", "s", "bord", "xbord", "ybord", "shad", "xshad", "yshad",
+    "be", "blur", "fn", "fs", "fscx", "fscy", "fsp", "fr", "frx", "fry", "frz",
+    "fax", "fay", "fe", "c", "1c", "2c", "3c", "4c", "alpha", "1a", "2a", "3a", "4a",
+    "a", "an", "k", "K", "kf", "ko", "q", "r", "pos", "move", "org", "fad", "fade",
+    "clip", "iclip", "p", "pbo", "t"
+};
+}
+
+TagFilter::TagFilter() :
+    _stripDrawings(false),
+    _empty(true)
+{}
+
+TagFilter::TagFilter(const QStringList& tags) :
+    _stripDrawings(false),
+    _empty(true)
+{
+    for (const char* const tag : knownTags)
+    {
+        this->insert(QString::fromLatin1(tag), false);
+    }
+
+    for (QString tag : tags)
+    {
+        tag = tag.trimmed();
+        if (tag.startsWith('\\')) tag.remove(0, 1);
+        if (tag.isEmpty()) continue;
+
+        this->insert(tag, true);
+        _empty = false;
+        if ("p" == tag) _stripDrawings = true;
+    }
+}
+
+bool TagFilter::isEmpty() const
+{
+    return _empty;
+}
+
+int TagFilter::symbol(const QChar c)
+{
+    const ushort u = c.unicode();
+    if (u >= 'a' && u <= 'z') return u - 'a';
+    if (u >= 'A' && u <= 'Z') return u - 'A' + 26;
+    if (u >= '0' && u <= '9') return u - '0' + 52;
+    return -1;
+}
+
+void TagFilter::insert(const QString& name, const bool strip)
+{
+    if (_nodes.isEmpty())
+    {
+        Node root;
+        std::fill(root.next, root.next + AlphabetSize, -1);
+        root.terminal = false;
+        root.strip = false;
+        _nodes.append(root);
+    }
+
+    int node = 0;
+    for (const QChar c : name)
+    {
+        const int s = symbol(c);
+        if (s < 0) return; // Такой тег в тексте всё равно не встретится
+
+        if (_nodes.at(node).next[s] < 0)
+        {
+            Node child;
+            std::fill(child.next, child.next + AlphabetSize, -1);
+            child.terminal = false;
+            child.strip = false;
+            _nodes.append(child);
+            _nodes[node].next[s] = _nodes.length() - 1;
+        }
+        node = _nodes.at(node).next[s];
+    }
+
+    _nodes[node].terminal = true;
+    _nodes[node].strip = _nodes.at(node).strip || strip;
+}
+
+// Длина самого длинного известного имени тега, начинающегося с from
+int TagFilter::match(const QString& text, const int from, bool& strip) const
+{
+    int node = 0, result = 0;
+    strip = false;
+
+    for (int i = from, len = text.length(); i < len; ++i)
+    {
+        const int s = symbol(text.at(i));
+        if (s < 0) break;
+
+        node = _nodes.at(node).next[s];
+        if (node < 0) break;
+
+        if (_nodes.at(node).terminal)
+        {
+            result = i + 1 - from;
+            strip = _nodes.at(node).strip;
+        }
+    }
+
+    return result;
+}
+
+bool TagFilter::apply(QString& text) const
+{
+    if (_empty || !text.contains('{')) return false;
+
+    QString result;
+    result.reserve(text.length());
+
+    bool inBlock = false, blockChanged = false, drawing = false, changed = false;
+    // Открытый \t(...): опустевшая обёртка удаляется, как и пустой блок
+    bool inTransform = false, transformChanged = false;
+    int blockStart = 0, transformStart = 0, transformDepth = 0, i = 0;
+    const int len = text.length();
+    while (i < len)
+    {
+        const QChar c = text.at(i);
+
+        // Обычный текст (или рисунок, если удаляем \p)
+        if (!inBlock)
+        {
+            if ('{' == c)
+            {
+                inBlock = true;
+                blockChanged = false;
+                blockStart = result.length();
+                result.append(c);
+            }
+            else if (drawing)
+            {
+                changed = true;
+            }
+            else
+            {
+                result.append(c);
+            }
+            ++i;
+            continue;
+        }
+
+        // Конец блока: от опустевшего блока ничего не оставляем
+        if ('}' == c)
+        {
+            inBlock = inTransform = false;
+            if (blockChanged && result.length() == blockStart + 1)
+            {
+                result.truncate(blockStart);
+            }
+            else
+            {
+                result.append(c);
+            }
+            ++i;
+            continue;
+        }
+
+        bool strip = false;
+        const int nameLen = '\\' == c ? this->match(text, i + 1, strip) : 0;
+        if (!strip)
+        {
+            if (!inTransform && 1 == nameLen && 't' == text.at(i + 1) && i + 2 < len && '(' == text.at(i + 2))
+            {
+                inTransform = true;
+                transformChanged = false;
+                transformStart = result.length();
+                transformDepth = 0;
+                result.append(text.midRef(i, 3));
+                i += 3;
+                continue;
+            }
+
+            if (inTransform && '(' == c)
+            {
+                ++transformDepth;
+            }
+            else if (inTransform && ')' == c && transformDepth-- == 0)
+            {
+                // В обёртке остались только времена - тегов нет
+                inTransform = false;
+                if (transformChanged && -1 == result.indexOf('\\', transformStart + 1))
+                {
+                    result.truncate(transformStart);
+                    ++i;
+                    continue;
+                }
+            }
+
+            result.append(c);
+            ++i;
+            continue;
+        }
+
+        // Пропускаем имя и аргумент тега
+        int j = i + 1 + nameLen;
+        const int argStart = j;
+        if (j < len && '(' == text.at(j))
+        {
+            for (int depth = 0; j < len; ++j)
+            {
+                const QChar a = text.at(j);
+                if ('(' == a)
+                {
+                    ++depth;
+                }
+                else if (')' == a && 0 == --depth)
+                {
+                    ++j;
+                    break;
+                }
+                else if ('}' == a)
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            while (j < len && '\\' != text.at(j) && '}' != text.at(j) && ')' != text.at(j)) ++j;
+        }
+
+        if (_stripDrawings && 1 == nameLen && 'p' == text.at(i + 1))
+        {
+            drawing = text.midRef(argStart, j - argStart).trimmed().toInt() > 0;
+        }
+
+        i = j;
+        changed = blockChanged = true;
+        if (inTransform) transformChanged = true;
+    }
+
+    if (changed) text = result;
+    return changed;
+}
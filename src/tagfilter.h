@@ -0,0 +1,57 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TAGFILTER_H
+#define TAGFILTER_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+
+// Удаление тегов оверрайда за один проход по тексту.
+// Все известные имена тегов собраны в один автомат (бор), поэтому
+// \b, \be, \blur и \bord различаются без отдельных регулярок.
+class TagFilter
+{
+public:
+    TagFilter();
+    explicit TagFilter(const QStringList& tags);
+
+    bool isEmpty() const;
+    bool apply(QString& text) const;
+
+private:
+    enum {AlphabetSize = 62};
+
+    struct Node
+    {
+        int  next[AlphabetSize];
+        bool terminal;
+        bool strip;
+    };
+
+    QVector<Node> _nodes;
+    bool _stripDrawings;
+    bool _empty;
+
+    static int symbol(const QChar c);
+    void insert(const QString& name, const bool strip);
+    int match(const QString& text, const int from, bool& strip) const;
+};
+
+#endif // TAGFILTER_H
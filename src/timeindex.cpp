@@ -0,0 +1,91 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "timeindex.h"
+#include <QRegExp>
+#include <algorithm>
+
+TimeIndex::TimeIndex(const QList<Script::Line::Event*>& events)
+{
+    _entries.reserve(events.length());
+    for (int i = 0, len = events.length(); i < len; ++i)
+    {
+        const Script::Line::Event* const e = events.at(i);
+        _entries.append({e->start(), e->end(), i});
+    }
+    std::stable_sort(_entries.begin(), _entries.end(), [](const Entry& a, const Entry& b) {
+        return a.start < b.start;
+    });
+
+    _maxEnd.resize(_entries.length());
+    this->build(0, _entries.length());
+}
+
+// Максимум конца в поддереве [lo, hi), хранится в середине
+uint TimeIndex::build(const int lo, const int hi)
+{
+    if (lo >= hi) return 0;
+
+    const int mid = lo + (hi - lo) / 2;
+    const uint left = this->build(lo, mid),
+               right = this->build(mid + 1, hi);
+    _maxEnd[mid] = std::max(_entries.at(mid).end, std::max(left, right));
+    return _maxEnd.at(mid);
+}
+
+void TimeIndex::collect(const int lo, const int hi, const uint start, const uint end, QVector<int>& result) const
+{
+    if (lo >= hi) return;
+
+    // Всё поддерево закончилось до окна
+    const int mid = lo + (hi - lo) / 2;
+    if (_maxEnd.at(mid) <= start) return;
+
+    this->collect(lo, mid, start, end, result);
+
+    // Правее начала только позже
+    const Entry& entry = _entries.at(mid);
+    if (entry.start >= end) return;
+    if (entry.end > start) result.append(entry.index);
+
+    this->collect(mid + 1, hi, start, end, result);
+}
+
+QVector<int> TimeIndex::query(const uint start, const uint end) const
+{
+    QVector<int> result;
+    if (start < end) this->collect(0, _entries.length(), start, end, result);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+bool TimeIndex::ParseRange(const QString& spec, uint& start, uint& end)
+{
+    const QString time = "(\\d+):(\\d{1,2}):(\\d{1,2})(?:[.,](\\d{1,3}))?";
+    QRegExp re(QString("^\\s*%1\\s*-\\s*%1\\s*$").arg(time));
+    if ( !re.exactMatch(spec) ) return false;
+
+    auto toTime = [&re](const int first) {
+        // Дробная часть: ".5" - это 500 мс, ".05" - 50 мс
+        const QString fraction = re.cap(first + 3).leftJustified(3, '0');
+        return ((re.cap(first).toUInt() * 60u + re.cap(first + 1).toUInt()) * 60u + re.cap(first + 2).toUInt()) * 1000u + fraction.toUInt();
+    };
+    start = toTime(1);
+    end   = toTime(5);
+    return start < end;
+}
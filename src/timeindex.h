@@ -0,0 +1,55 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMEINDEX_H
+#define TIMEINDEX_H
+
+#include "script.h"
+#include <QVector>
+
+// Индекс событий по времени: массив, отсортированный по началу,
+// с максимумом конца по неявному дереву (середина диапазона - корень).
+// Запрос пересечения с окном - O(log n + k).
+// Индекс хранит номера событий, поэтому после изменения списка его надо строить заново.
+class TimeIndex
+{
+public:
+    explicit TimeIndex(const QList<Script::Line::Event*>& events);
+
+    // Номера событий, пересекающих [start, end), в порядке следования в скрипте
+    QVector<int> query(const uint start, const uint end) const;
+
+    // "0:01:02.50-0:01:10" (допустимы и миллисекунды через запятую)
+    static bool ParseRange(const QString& spec, uint& start, uint& end);
+
+private:
+    struct Entry
+    {
+        uint start;
+        uint end;
+        int  index;
+    };
+
+    QVector<Entry> _entries;
+    QVector<uint>  _maxEnd;
+
+    uint build(const int lo, const int hi);
+    void collect(const int lo, const int hi, const uint start, const uint end, QVector<int>& result) const;
+};
+
+#endif // TIMEINDEX_H
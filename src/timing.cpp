@@ -0,0 +1,374 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "timing.h"
+#include <QtConcurrent>
+#include <QThread>
+#include <QRegExp>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <algorithm>
+#include <limits>
+
+namespace Timing
+{
+namespace
+{
+// Мелкие куски не стоит отдавать в пул
+const int minChunk = 4096;
+
+// Ключ упакован в одно число: сравнение без разыменования указателей
+struct SortKey
+{
+    quint64 time;   // Начало в старших 32 битах, слой - в младших
+    int     index;
+
+    bool operator<(const SortKey& other) const
+    {
+        return time < other.time || (time == other.time && index < other.index);
+    }
+};
+
+// Ограничения, при которых вычисления в Apply не переполняются
+const quint64 maxScaleTerm = Q_UINT64_C(1) << 28;
+const qint64 maxShift = Q_INT64_C(1) << 32;
+
+template <typename T>
+T Gcd(T a, T b)
+{
+    while (b)
+    {
+        const T r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+struct MergeSpan
+{
+    int first;
+    int middle;
+    int last;
+};
+
+QVector<SortKey> MakeKeys(const QList<Script::Line::Event*>& events)
+{
+    QVector<SortKey> keys(events.length());
+    for (int i = 0, len = events.length(); i < len; ++i)
+    {
+        const Script::Line::Event* const e = events.at(i);
+        keys[i] = {(static_cast<quint64>(e->start()) << 32) | e->layer(), i};
+    }
+    return keys;
+}
+
+// Номер в ключе уникален, поэтому порядок полный и std::sort устойчив по сути
+void SortKeys(QVector<SortKey>& keys)
+{
+    const int chunks = std::min(QThread::idealThreadCount(), keys.length() / minChunk);
+    if (chunks < 2)
+    {
+        std::sort(keys.begin(), keys.end());
+        return;
+    }
+
+    QVector< QPair<int, int> > ranges;
+    for (int i = 0; i < chunks; ++i)
+    {
+        ranges.append( qMakePair(keys.length() * i / chunks, keys.length() * (i + 1) / chunks) );
+    }
+
+    SortKey* const data = keys.data();
+    QtConcurrent::blockingMap(ranges, [data](const QPair<int, int>& range) {
+        std::sort(data + range.first, data + range.second);
+    });
+
+    // Попарное слияние соседних кусков, каждый уровень - параллельно.
+    // Непарный последний кусок сливается с пустым, то есть просто копируется.
+    QVector<SortKey> buffer(keys.length());
+    while (ranges.length() > 1)
+    {
+        QVector<MergeSpan> spans;
+        QVector< QPair<int, int> > merged;
+        for (int i = 0; i < ranges.length(); i += 2)
+        {
+            const int last = i + 1 < ranges.length() ? ranges.at(i + 1).second : ranges.at(i).second;
+            spans.append({ranges.at(i).first, ranges.at(i).second, last});
+            merged.append( qMakePair(ranges.at(i).first, last) );
+        }
+
+        const SortKey* const src = keys.constData();
+        SortKey* const dst = buffer.data();
+        QtConcurrent::blockingMap(spans, [src, dst](const MergeSpan& span) {
+            std::merge(src + span.first, src + span.middle, src + span.middle, src + span.last, dst + span.first);
+        });
+
+        keys.swap(buffer);
+        ranges = merged;
+    }
+}
+}
+
+Retime::Retime() :
+    shift(0),
+    scaleNum(1),
+    scaleDen(1)
+{}
+
+bool Retime::isIdentity() const
+{
+    return 0 == shift && scaleNum == scaleDen;
+}
+
+bool ParseFrameRate(const QString& str, quint32& num, quint32& den)
+{
+    QRegExp re("^\\s*(\\d{1,6})(?:\\.(\\d{1,3})|/(\\d{1,6}))?\\s*$");
+    if ( !re.exactMatch(str) ) return false;
+
+    num = re.cap(1).toUInt();
+    den = 1;
+    if ( !re.cap(2).isEmpty() )
+    {
+        for (int i = 0; i < re.cap(2).length(); ++i)
+        {
+            num = num * 10u + static_cast<quint32>(re.cap(2).at(i).digitValue());
+            den *= 10u;
+        }
+    }
+    else if ( !re.cap(3).isEmpty() )
+    {
+        den = re.cap(3).toUInt();
+    }
+    if (0 == num || 0 == den) return false;
+
+    const quint32 divisor = Gcd(num, den);
+    num /= divisor;
+    den /= divisor;
+    return true;
+}
+
+// Время на экране сохраняется в кадрах: t' = t * from / to
+bool ParseScale(const QString& spec, Retime& retime)
+{
+    const QStringList rates = spec.split(':');
+    quint32 fromNum, fromDen, toNum, toDen;
+    if ( rates.length() != 2 || !ParseFrameRate(rates.first(), fromNum, fromDen) || !ParseFrameRate(rates.last(), toNum, toDen) ) return false;
+
+    quint64 num = static_cast<quint64>(fromNum) * toDen,
+            den = static_cast<quint64>(fromDen) * toNum;
+    const quint64 divisor = Gcd(num, den);
+    num /= divisor;
+    den /= divisor;
+    if (num > maxScaleTerm || den > maxScaleTerm) return false;
+
+    retime.scaleNum = static_cast<quint32>(num);
+    retime.scaleDen = static_cast<quint32>(den);
+    return true;
+}
+
+void Apply(QList<Script::Line::Event*>& events, const Retime& retime, const uint unit)
+{
+    // Начала и концы подряд в одном массиве: цикл без ветвлений по полям события
+    QVector<qint64> times(events.length() * 2);
+    qint64* const data = times.data();
+    for (int i = 0, len = events.length(); i < len; ++i)
+    {
+        data[2 * i]     = events.at(i)->start();
+        data[2 * i + 1] = events.at(i)->end();
+    }
+
+    // Сдвиг приведён к знаменателю масштаба, деление с округлением
+    // до ближайшего кратного unit: TimeToStr для SSA/ASS отбрасывает миллисекунды.
+    // t < 2^32 и num, den < 2^28, так что произведения помещаются в 64 бита.
+    const qint64 num = retime.scaleNum,
+                 divisor = static_cast<qint64>(retime.scaleDen) * unit,
+                 offset = qBound(-maxShift, retime.shift, maxShift) * retime.scaleDen,
+                 maxTime = std::numeric_limits<uint>::max() / unit * unit;
+    for (int i = 0, len = times.length(); i < len; ++i)
+    {
+        const qint64 value = data[i] * num + offset;
+        const qint64 rounded = (std::max(value, Q_INT64_C(0)) + divisor / 2) / divisor * unit;
+        data[i] = std::min(rounded, maxTime);
+    }
+
+    for (int i = 0, len = events.length(); i < len; ++i)
+    {
+        events.at(i)->setStart( static_cast<uint>(data[2 * i]) );
+        events.at(i)->setEnd( static_cast<uint>(data[2 * i + 1]) );
+    }
+}
+
+//
+// Границы кадров
+//
+FrameGrid::FrameGrid() :
+    _frameDuration(0.0)
+{}
+
+bool FrameGrid::isEmpty() const
+{
+    return _boundaries.isEmpty() && _frameDuration <= 0.0;
+}
+
+bool FrameGrid::load(const QString& source, QString* error)
+{
+    _boundaries.clear();
+    _frameDuration = 0.0;
+
+    quint32 num, den;
+    if ( !QFileInfo::exists(source) && ParseFrameRate(source, num, den) )
+    {
+        _frameDuration = 1000000.0 * den / num;
+        return true;
+    }
+
+    QFile file(source);
+    if ( !file.open(QFile::ReadOnly | QFile::Text) )
+    {
+        if (error) *error = QString("Can't read file \"%1\".").arg(source);
+        return false;
+    }
+
+    QTextStream in(&file);
+    const QString header = in.readLine().trimmed();
+    if ( !header.startsWith("# timecode format v2", Qt::CaseInsensitive) )
+    {
+        if (error) *error = QString("\"%1\" is not a v2 timecodes file.").arg(source);
+        return false;
+    }
+
+    for (int lineNumber = 2; !in.atEnd(); ++lineNumber)
+    {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+
+        bool ok;
+        const qint64 time = qRound64(line.toDouble(&ok) * 1000.0);
+        if (!ok || time < 0 || (!_boundaries.isEmpty() && time < _boundaries.last()))
+        {
+            if (error) *error = QString("Invalid timecode at \"%1\", line %2.").arg(source).arg(lineNumber);
+            _boundaries.clear();
+            return false;
+        }
+        _boundaries.append(time);
+    }
+
+    if (_boundaries.isEmpty())
+    {
+        if (error) *error = QString("\"%1\" contains no timecodes.").arg(source);
+        return false;
+    }
+    return true;
+}
+
+// Ближайшая граница. cursor - позиция предыдущего поиска: от неё поиск идёт
+// галопом в нужную сторону, затем двоичный в найденном окне. Для соседних
+// времён это O(1) в среднем, для возрастающих - линейно в сумме.
+qint64 FrameGrid::nearest(const qint64 time, int& cursor) const
+{
+    if (_boundaries.isEmpty())
+    {
+        return qRound64(qRound64(time / _frameDuration) * _frameDuration);
+    }
+
+    // Ищем первую границу >= time в окне [lo, hi]
+    const qint64* const data = _boundaries.constData();
+    const int len = _boundaries.length();
+    int lo = cursor, hi = cursor;
+    if (lo > 0 && data[lo - 1] >= time)
+    {
+        for (int step = 1; lo > 0 && data[lo - 1] >= time; step *= 2)
+        {
+            hi = lo - 1;
+            lo = std::max(lo - step, 0);
+        }
+    }
+    else
+    {
+        for (int step = 1; hi < len && data[hi] < time; step *= 2)
+        {
+            lo = hi + 1;
+            hi = std::min(hi + step, len);
+        }
+    }
+    cursor = static_cast<int>(std::lower_bound(data + lo, data + hi, time) - data);
+
+    // После последнего кадра времени не меняем
+    if (cursor >= len) return time;
+    if (cursor > 0 && time - data[cursor - 1] <= data[cursor] - time) return data[cursor - 1];
+    return data[cursor];
+}
+
+int FrameGrid::snap(QList<Script::Line::Event*>& events, const uint unit) const
+{
+    // Начала и концы - двумя отдельными проходами со своими курсорами:
+    // у отсортированных событий оба ряда почти монотонны
+    const qint64 step = 1000 * static_cast<qint64>(unit),
+                 maxTime = std::numeric_limits<uint>::max() / unit * unit;
+    int changed = 0, startCursor = 0, endCursor = 0;
+    auto snapTime = [&](const uint time, int& cursor) {
+        const qint64 boundary = this->nearest(static_cast<qint64>(time) * 1000, cursor);
+        const uint value = static_cast<uint>( std::min((boundary + step - 1) / step * unit, maxTime) );
+        if (time != value) ++changed;
+        return value;
+    };
+
+    for (Script::Line::Event* const e : qAsConst(events))
+    {
+        e->setStart( snapTime(e->start(), startCursor) );
+        e->setEnd( snapTime(e->end(), endCursor) );
+    }
+
+    return changed;
+}
+
+void Sort(QList<Script::Line::Event*>& events)
+{
+    QVector<SortKey> keys = MakeKeys(events);
+    SortKeys(keys);
+
+    QList<Script::Line::Event*> sorted;
+    sorted.reserve(events.length());
+    for (const SortKey& key : qAsConst(keys)) sorted.append( events.at(key.index) );
+    events = sorted;
+}
+
+Diagnostics Diagnose(const QList<Script::Line::Event*>& events, const int styleCount)
+{
+    Diagnostics result = {0, 0};
+
+    QVector<SortKey> keys = MakeKeys(events);
+    if ( !std::is_sorted(keys.constBegin(), keys.constEnd()) ) SortKeys(keys);
+
+    // Самый поздний конец среди уже пройденных строк каждого стиля
+    QVector<uint> lastEnd(styleCount, 0);
+    for (const SortKey& key : qAsConst(keys))
+    {
+        const Script::Line::Event* const e = events.at(key.index);
+        if (e->end() < e->start()) ++result.negativeDurations;
+
+        const int style = e->styleId();
+        if (e->start() < lastEnd.at(style)) ++result.styleOverlaps;
+        lastEnd[style] = std::max(lastEnd.at(style), e->end());
+    }
+
+    return result;
+}
+}
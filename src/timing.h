@@ -0,0 +1,80 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "script.h"
+#include <QVector>
+
+// Операции над временем событий
+namespace Timing
+{
+// Пересчёт времени: t * scaleNum / scaleDen + shift, с насыщением в [0, UINT_MAX]
+struct Retime
+{
+    qint64  shift;
+    quint32 scaleNum;
+    quint32 scaleDen;
+
+    Retime();
+    bool isIdentity() const;
+};
+
+struct Diagnostics
+{
+    int negativeDurations;  // Конец раньше начала
+    int styleOverlaps;      // Dialogue начинается до конца предыдущей строки того же стиля
+};
+
+// "25", "23.976" или "24000/1001"
+bool ParseFrameRate(const QString& str, quint32& num, quint32& den);
+// "FROM:TO" - переход между частотами кадров
+bool ParseScale(const QString& spec, Retime& retime);
+// Все времена за один проход; результат округляется до unit миллисекунд
+void Apply(QList<Script::Line::Event*>& events, const Retime& retime, const uint unit);
+
+// Границы кадров: файл timecodes v2 (mkvextract) или постоянная частота
+class FrameGrid
+{
+public:
+    FrameGrid();
+
+    bool load(const QString& source, QString* error = nullptr);
+    bool isEmpty() const;
+
+    // Переносит начала и концы на ближайшую границу кадра, округляя вверх
+    // до unit миллисекунд, чтобы время оставалось внутри своего кадра.
+    // По отсортированным временам - за линейное время. Возвращает число изменённых.
+    int snap(QList<Script::Line::Event*>& events, const uint unit) const;
+
+private:
+    QVector<qint64> _boundaries;    // Микросекунды, по возрастанию
+    double _frameDuration;          // Микросекунды, для постоянной частоты
+
+    qint64 nearest(const qint64 time, int& cursor) const;
+};
+
+// Устойчивая параллельная сортировка по (началу, слою, исходному номеру)
+void Sort(QList<Script::Line::Event*>& events);
+// Проход заметающей прямой; порядок событий не меняет.
+// styleCount - размер таблицы стилей Script::names.styles.
+Diagnostics Diagnose(const QList<Script::Line::Event*>& events, const int styleCount);
+}
+
+#endif // TIMING_H
@@ -0,0 +1,137 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+namespace Trace
+{
+namespace
+{
+struct Event
+{
+    const char* name;
+    QString arg;
+    qint64 start;
+    qint64 end;
+};
+
+struct Buffer
+{
+    int tid;
+    QString threadName;
+    QMutex mutex;
+    QVector<Event> events;
+};
+
+QAtomicInt enabled(0);
+QElapsedTimer timer;
+QMutex registryMutex;
+QList<Buffer*> registry;
+
+// Буфер потока регистрируется при первом отрезке и живёт до конца программы:
+// потоки пула могут завершиться раньше записи
+Buffer* ThreadBuffer()
+{
+    static thread_local Buffer* buffer = nullptr;
+    if (!buffer)
+    {
+        QMutexLocker locker(&registryMutex);
+        buffer = new Buffer;
+        buffer->tid = registry.length() + 1;
+        buffer->threadName = QThread::currentThread()->objectName();
+        if (buffer->threadName.isEmpty()) buffer->threadName = QString("Thread %1").arg(buffer->tid);
+        registry.append(buffer);
+    }
+    return buffer;
+}
+
+// Микросекунды с дробной частью
+double Micro(const qint64 nsecs)
+{
+    return static_cast<double>(nsecs) / 1000.0;
+}
+}
+
+void Start()
+{
+    timer.start();
+    enabled = 1;
+}
+
+bool IsEnabled()
+{
+    return enabled.load();
+}
+
+bool Write(const QString& fileName)
+{
+    enabled = 0;
+
+    QJsonArray events;
+    QMutexLocker registryLocker(&registryMutex);
+    for (Buffer* const buffer : qAsConst(registry))
+    {
+        QMutexLocker locker(&buffer->mutex);
+        events.append(QJsonObject{{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", buffer->tid},
+                                  {"args", QJsonObject{{"name", buffer->threadName}}}});
+
+        for (const Event& e : qAsConst(buffer->events))
+        {
+            QJsonObject object{{"name", e.name}, {"ph", "X"}, {"pid", 1}, {"tid", buffer->tid},
+                               {"ts", Micro(e.start)}, {"dur", Micro(e.end - e.start)}};
+            if (!e.arg.isEmpty()) object.insert("args", QJsonObject{{"file", e.arg}});
+            events.append(object);
+        }
+    }
+
+    QFile file(fileName);
+    if ( !file.open(QFile::WriteOnly) ) return false;
+    const QByteArray data = QJsonDocument(QJsonObject{{"traceEvents", events}, {"displayTimeUnit", "ms"}}).toJson(QJsonDocument::Compact);
+    return file.write(data) == data.size();
+}
+
+Span::Span(const char* name, const QString& arg) :
+    _name(nullptr),
+    _start(0)
+{
+    if ( !enabled.load() ) return;
+
+    _name = name;
+    _arg = arg;
+    _start = timer.nsecsElapsed();
+}
+
+Span::~Span()
+{
+    if (!_name) return;
+
+    const qint64 end = timer.nsecsElapsed();
+    Buffer* const buffer = ThreadBuffer();
+    QMutexLocker locker(&buffer->mutex);
+    buffer->events.append({_name, _arg, _start, end});
+}
+}
@@ -0,0 +1,49 @@
+/*
+ * This file is part of SubCleaner.
+ * Copyright (C) 2014-2019  Andrey Efremov <duxus@yandex.ru>
+ *
+ * SubCleaner is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SubCleaner is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SubCleaner.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+
+// Трассировка в формате Chrome trace JSON (открывается в Perfetto).
+// Каждый поток пишет в свой буфер; выключенная трассировка стоит
+// одной проверки флага на отрезок.
+namespace Trace
+{
+void Start();
+bool IsEnabled();
+// Вызывать, когда рабочие потоки закончили
+bool Write(const QString& fileName);
+
+// Отрезок от создания до разрушения в текущем потоке
+class Span
+{
+public:
+    // name должна жить до конца программы (строковый литерал)
+    explicit Span(const char* name, const QString& arg = QString());
+    ~Span();
+
+private:
+    const char* _name;
+    QString _arg;
+    qint64 _start;
+};
+}
+
+#endif // TRACE_H